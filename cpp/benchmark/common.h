@@ -0,0 +1,32 @@
+// Helpers shared by the hanabi text benchmarks.
+
+#pragma once
+
+#include <random>
+#include <vector>
+
+#include "hanabi-learning-environment/hanabi_lib/hanabi_game.h"
+#include "hanabi-learning-environment/hanabi_lib/hanabi_state.h"
+
+namespace hle = hanabi_learning_env;
+
+// every state of numGame games of uniformly random legal moves where a
+// player is to act
+inline std::vector<hle::HanabiState> playRandomGames(
+    const hle::HanabiGame& game, int numGame, int seed) {
+  std::mt19937 rng(seed);
+  std::vector<hle::HanabiState> states;
+  for (int i = 0; i < numGame; ++i) {
+    hle::HanabiState state(&game);
+    while (!state.IsTerminal()) {
+      if (state.CurPlayer() == hle::kChancePlayerId) {
+        state.ApplyRandomChance();
+        continue;
+      }
+      states.push_back(state);
+      auto moves = state.LegalMoves(state.CurPlayer());
+      state.ApplyMove(moves[rng() % moves.size()]);
+    }
+  }
+  return states;
+}
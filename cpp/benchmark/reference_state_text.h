@@ -0,0 +1,60 @@
+// The text description of a hanabi state as HanabiState::ToTokenizeText()
+// built it by string concatenation before RenderState(), kept as reference
+// for the state_text and state_tokenize benchmarks.
+
+#pragma once
+
+#include <string>
+
+#include "hanabi-learning-environment/hanabi_lib/hanabi_state.h"
+#include "hanabi-learning-environment/hanabi_lib/util.h"
+
+namespace hle = hanabi_learning_env;
+
+inline std::string referenceStateText(const hle::HanabiState& state) {
+  std::string result;
+  std::string hand_info;
+  std::string knowledge_info;
+  result += std::to_string(state.ParentGame()->NumPlayers()) + " player game. ";
+  result += std::to_string(state.InformationTokens()) + " clue tokens available. ";
+  result += std::to_string(state.LifeTokens()) + " life tokens remaining. ";
+  result += "fireworks display: ";
+  for (int i = 0; i < state.ParentGame()->NumColors(); ++i) {
+    result += hle::convertColorInitial(hle::ColorIndexToChar(i)) + " ";
+    result += std::to_string(state.Fireworks()[i]) + " ";
+  }
+  const auto& hands = state.Hands();
+  int numHands = static_cast<int>(hands.size());
+  for (int i = 0; i < numHands; ++i) {
+    if (i == state.CurPlayer()) {
+      result += ". knowledge about own hand: ";
+      for (size_t j = 0; j < hands[i].Knowledge().size(); ++j) {
+        knowledge_info = hands[i].Knowledge()[j].ToString();
+        result += hle::convertColorInitial(knowledge_info[0]) + " ";
+        result += ((knowledge_info[1] == 'X') ? "Unknown" : std::string(1, knowledge_info[1]))
+            + " ";
+      }
+    }
+  }
+  int counter = 1;
+  for (int i = 0; i < numHands; ++i) {
+    if (i != state.CurPlayer()) {
+      result += ". Player +" + std::to_string(counter) + " hand: ";
+      for (size_t j = 0; j < hands[i].Cards().size(); ++j) {
+        hand_info = hands[i].Cards()[j].ToString();
+        result += hle::convertColorInitial(hand_info[hand_info.find(' ') + 1]) + " "
+            + hand_info.back() + " ";
+      }
+      result += ". Player +" + std::to_string(counter) + " revealed information: ";
+      for (size_t k = 0; k < hands[i].Knowledge().size(); ++k) {
+        knowledge_info = hands[i].Knowledge()[k].ToString();
+        result += hle::convertColorInitial(knowledge_info[0]) + " ";
+        result += ((knowledge_info[1] == 'X') ? "Unknown" : std::string(1, knowledge_info[1]))
+            + " ";
+      }
+      counter += 1;
+    }
+  }
+  result = result + '.';
+  return result;
+}
@@ -0,0 +1,88 @@
+// Text description of hanabi states, from the RenderState() template
+// renderer into a reused buffer vs the previous string concatenation of
+// HanabiState::ToTokenizeText(), see reference_state_text.h. Plays numGame
+// random games for every player count in 2..5, with the default hand size
+// and with handSize if it differs, checks every state where a player is to
+// act renders the same text both ways, then reports states/sec of both.
+// Exits with 1 on any mismatch.
+//
+// usage: state_text [numGame=200] [handSize=4] [seed=1]
+
+#include <cassert>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+#include "hanabi-learning-environment/hanabi_lib/hanabi_game.h"
+#include "hanabi-learning-environment/hanabi_lib/hanabi_state.h"
+#include "hanabi-learning-environment/hanabi_lib/state_text.h"
+
+#include "cpp/benchmark/common.h"
+#include "cpp/benchmark/reference_state_text.h"
+
+using Clock = std::chrono::steady_clock;
+
+int main(int argc, char** argv) {
+  int numGame = argc > 1 ? std::stoi(argv[1]) : 200;
+  int handSize = argc > 2 ? std::stoi(argv[2]) : 4;
+  int seed = argc > 3 ? std::stoi(argv[3]) : 1;
+
+  std::cout << std::setw(8) << "players" << std::setw(6) << "hand" << std::setw(10)
+            << "states" << std::setw(12) << "mismatch" << std::setw(16) << "reference/s"
+            << std::setw(16) << "renderer/s" << std::endl;
+  int numMismatch = 0;
+  for (int numPlayer = 2; numPlayer <= 5; ++numPlayer) {
+    int defaultHandSize = -1;
+    for (int hand : {-1, handSize}) {
+      std::unordered_map<std::string, std::string> params = {
+          {"players", std::to_string(numPlayer)}, {"seed", std::to_string(seed)}};
+      if (hand > 0) {
+        params["hand_size"] = std::to_string(hand);
+      }
+      hle::HanabiGame game(params);
+      if (hand < 0) {
+        defaultHandSize = game.HandSize();
+      } else if (hand == defaultHandSize) {
+        continue;
+      }
+      auto states = playRandomGames(game, numGame, seed);
+
+      std::string text;
+      int mismatch = 0;
+      for (const auto& state : states) {
+        text.clear();
+        hle::AppendStateText(state, true, &text);
+        if (text != referenceStateText(state)) {
+          if (numMismatch + mismatch == 0) {
+            std::cout << "mismatch:\n  " << referenceStateText(state) << "\n  " << text
+                      << std::endl;
+          }
+          ++mismatch;
+        }
+      }
+      numMismatch += mismatch;
+
+      size_t numChar = 0;
+      auto begin = Clock::now();
+      for (const auto& state : states) {
+        numChar += referenceStateText(state).size();
+      }
+      double referenceSec = std::chrono::duration<double>(Clock::now() - begin).count();
+
+      begin = Clock::now();
+      for (const auto& state : states) {
+        text.clear();
+        hle::AppendStateText(state, true, &text);
+        numChar -= text.size();
+      }
+      double rendererSec = std::chrono::duration<double>(Clock::now() - begin).count();
+      assert(numChar == 0);
+
+      std::cout << std::fixed << std::setprecision(0) << std::setw(8) << numPlayer
+                << std::setw(6) << game.HandSize() << std::setw(10) << states.size()
+                << std::setw(12) << mismatch << std::setw(16) << states.size() / referenceSec
+                << std::setw(16) << states.size() / rendererSec << std::endl;
+    }
+  }
+  return numMismatch == 0 ? 0 : 1;
+}
@@ -0,0 +1,90 @@
+// Token ids of the text description of hanabi states, from StateTokenizer's
+// precompiled fragment table vs building the text by the previous string
+// concatenation (reference_state_text.h, independent of the RenderState()
+// walk the table is driven by) and running the tokenizer on it. Plays
+// numGame random games for every player count in 2..5, checks every state
+// where a player is to act gives the same ids both ways, then reports
+// tokens/sec of both. Exits with 1 on any mismatch.
+//
+// usage: state_tokenize [tokenizer=hanabi-learning-environment/hanabi_lib/dist/tokenizer.json]
+//                       [numGame=200] [seed=1]
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#include <tokenizers_cpp.h>
+
+#include "hanabi-learning-environment/hanabi_lib/hanabi_game.h"
+#include "hanabi-learning-environment/hanabi_lib/hanabi_state.h"
+#include "hanabi-learning-environment/hanabi_lib/state_tokenizer.h"
+
+#include "cpp/benchmark/common.h"
+#include "cpp/benchmark/reference_state_text.h"
+
+using Clock = std::chrono::steady_clock;
+
+int main(int argc, char** argv) {
+  std::string path =
+      argc > 1 ? argv[1] : "hanabi-learning-environment/hanabi_lib/dist/tokenizer.json";
+  int numGame = argc > 2 ? std::stoi(argv[2]) : 200;
+  int seed = argc > 3 ? std::stoi(argv[3]) : 1;
+
+  std::ifstream fs(path, std::ios::in | std::ios::binary);
+  if (fs.fail()) {
+    std::cerr << "Cannot open " << path << std::endl;
+    return 1;
+  }
+  std::string blob((std::istreambuf_iterator<char>(fs)), std::istreambuf_iterator<char>());
+  auto tok = tokenizers::Tokenizer::FromBlobJSON(blob);
+
+  auto begin = Clock::now();
+  hle::StateTokenizer tokenizer([&](const std::string& text) { return tok->Encode(text); });
+  double buildMs = std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+  std::cout << "table built in " << std::fixed << std::setprecision(1) << buildMs << " ms"
+            << std::endl;
+
+  std::cout << std::setw(8) << "players" << std::setw(10) << "states" << std::setw(12)
+            << "mismatch" << std::setw(18) << "text tokens/s" << std::setw(18)
+            << "table tokens/s" << std::endl;
+  int numMismatch = 0;
+  for (int numPlayer = 2; numPlayer <= 5; ++numPlayer) {
+    hle::HanabiGame game({{"players", std::to_string(numPlayer)},
+                          {"seed", std::to_string(seed)}});
+    auto states = playRandomGames(game, numGame, seed);
+
+    int mismatch = 0;
+    for (const auto& state : states) {
+      std::vector<int> ids;
+      tokenizer.Tokenize(state, &ids);
+      if (ids != tok->Encode(referenceStateText(state))) {
+        if (numMismatch + mismatch == 0) {
+          std::cout << "mismatch: " << referenceStateText(state) << std::endl;
+        }
+        ++mismatch;
+      }
+    }
+    numMismatch += mismatch;
+
+    int64_t numToken = 0;
+    begin = Clock::now();
+    for (const auto& state : states) {
+      numToken += tok->Encode(referenceStateText(state)).size();
+    }
+    double textSec = std::chrono::duration<double>(Clock::now() - begin).count();
+
+    std::vector<int> ids;
+    begin = Clock::now();
+    for (const auto& state : states) {
+      ids.clear();
+      tokenizer.Tokenize(state, &ids);
+    }
+    double tableSec = std::chrono::duration<double>(Clock::now() - begin).count();
+
+    std::cout << std::setprecision(0) << std::setw(8) << numPlayer << std::setw(10)
+              << states.size() << std::setw(12) << mismatch << std::setw(18)
+              << numToken / textSec << std::setw(18) << numToken / tableSec << std::endl;
+  }
+  return numMismatch == 0 ? 0 : 1;
+}
@@ -0,0 +1,81 @@
+// Startup cost of the tokenizer behind HanabiState::ToTokenize against the
+// number of actor threads. For 1, 2, 4, ... maxThread threads, reports the
+// wall time until every thread has the ids of its first state and the RSS
+// while all of them are alive. The first round pays the one time load of
+// the shared table, the later ones only the per thread cost.
+//
+// usage: tokenizer_startup [tokenizer=hanabi-learning-environment/hanabi_lib/dist/tokenizer.json]
+//                          [maxThread=64]
+
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "hanabi-learning-environment/hanabi_lib/hanabi_game.h"
+#include "hanabi-learning-environment/hanabi_lib/hanabi_state.h"
+#include "hanabi-learning-environment/hanabi_lib/state_tokenizer.h"
+
+namespace hle = hanabi_learning_env;
+using Clock = std::chrono::steady_clock;
+
+static double rssMb() {
+  std::ifstream statm("/proc/self/statm");
+  long size = 0;
+  long resident = 0;
+  statm >> size >> resident;
+  return resident * (double)sysconf(_SC_PAGESIZE) / (1 << 20);
+}
+
+int main(int argc, char** argv) {
+  hle::SetTokenizerPath(
+      argc > 1 ? argv[1] : "hanabi-learning-environment/hanabi_lib/dist/tokenizer.json");
+  int maxThread = argc > 2 ? std::stoi(argv[2]) : 64;
+
+  hle::HanabiGame game({{"players", "2"}, {"seed", "1"}});
+  std::cout << "baseline rss: " << std::fixed << std::setprecision(1) << rssMb() << " MB"
+            << std::endl;
+  std::cout << std::setw(10) << "threads" << std::setw(14) << "startup_ms" << std::setw(12)
+            << "rss_mb" << std::endl;
+  for (int numThread = 1; numThread <= maxThread; numThread *= 2) {
+    // dealt here, chance moves draw from the rng of the shared game
+    std::vector<hle::HanabiState> states;
+    for (int i = 0; i < numThread; ++i) {
+      states.emplace_back(&game);
+      while (states.back().CurPlayer() == hle::kChancePlayerId) {
+        states.back().ApplyRandomChance();
+      }
+    }
+
+    std::atomic<int> numReady{0};
+    std::atomic<bool> release{false};
+    std::vector<std::thread> threads;
+    auto begin = Clock::now();
+    for (int i = 0; i < numThread; ++i) {
+      threads.emplace_back([&, i]() {
+        states[i].ToTokenize();
+        ++numReady;
+        while (!release) {
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+      });
+    }
+    while (numReady < numThread) {
+      std::this_thread::yield();
+    }
+    double ms = std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+    double rss = rssMb();
+    release = true;
+    for (auto& t : threads) {
+      t.join();
+    }
+    std::cout << std::setw(10) << numThread << std::setw(14) << ms << std::setw(12) << rss
+              << std::endl;
+  }
+  return 0;
+}
@@ -56,6 +56,17 @@ class HanabiEnv {
     return game_.HandSize() * game_.NumColors() * game_.NumRanks();
   }
 
+  // leading 0/1 features of priv_s, the card knowledge (v0 belief) section
+  // at the end is not binary
+  int binaryFeatureSize() const {
+    auto encoder = hle::CanonicalObservationEncoder(&game_);
+    int size = encoder.Shape()[0];
+    if (game_.ObservationType() != hle::HanabiGame::kMinimal) {
+      size -= hle::CardKnowledgeSectionLength(game_);
+    }
+    return size;
+  }
+
   int getLastAction() const {
     return game_.GetMoveUid(lastMove_);
   }
@@ -83,6 +94,7 @@ class HanabiEnv {
       state_->ApplyRandomChance();
     }
     numStep_ = 0;
+    ++stateVersion_;
     moves_.clear();
   }
 
@@ -95,6 +107,7 @@ class HanabiEnv {
       state_->ApplyRandomChance();
     }
     numStep_ = 0;
+    ++stateVersion_;
   }
 
   void step(hle::HanabiMove move) {
@@ -105,6 +118,7 @@ class HanabiEnv {
     moves_.push_back(move);
 
     auto [r, t] = applyMove(*state_, move, numStep_ == maxLen_);
+    ++stateVersion_;
     if (t) {
       lastEpisodeScore_ = state_->Score();
     }
@@ -159,6 +173,33 @@ class HanabiEnv {
     return *state_;
   }
 
+  // HanabiState::ToTokenize() of the current state as a [maxStateTokens]
+  // int tensor, computed on the first call after each move and shared by
+  // every player observing it. The text is written from the view of the
+  // current player, so one entry per state serves all observers. Callers
+  // must not modify the returned tensor.
+  torch::Tensor getStateTokens() const {
+    updateStateTokens();
+    return stateTokens_;
+  }
+
+  // number of ids in getStateTokens() before the padding, as a scalar int
+  // tensor, the attention mask is arange(maxStateTokens) < length
+  torch::Tensor getStateTokenLength() const {
+    updateStateTokens();
+    return stateTokenLength_;
+  }
+
+  void setMaxStateTokens(int maxStateTokens) {
+    assert(maxStateTokens > 0);
+    maxStateTokens_ = maxStateTokens;
+    tokensVersion_ = -1;
+  }
+
+  int maxStateTokens() const {
+    return maxStateTokens_;
+  }
+
   const hle::HanabiGame& getHleGame() const {
     return game_;
   }
@@ -188,6 +229,17 @@ class HanabiEnv {
   }
 
  protected:
+  void updateStateTokens() const {
+    assert(state_ != nullptr);
+    if (tokensVersion_ == stateVersion_) {
+      return;
+    }
+    int length = 0;
+    stateTokens_ = torch::tensor(state_->ToTokenize(maxStateTokens_, &length));
+    stateTokenLength_ = torch::tensor(length, torch::kInt32);
+    tokensVersion_ = stateVersion_;
+  }
+
   const hle::HanabiGame game_;
   std::unique_ptr<hle::HanabiState> state_;
   const int maxLen_;
@@ -201,4 +253,11 @@ class HanabiEnv {
 
   float colorReward_ = -1;
   std::vector<hle::HanabiMove> moves_;
+
+  // bumped whenever state_ changes, invalidates stateTokens_
+  int64_t stateVersion_ = 0;
+  int maxStateTokens_ = hle::HanabiState::kDefaultMaxTokens;
+  mutable int64_t tokensVersion_ = -1;
+  mutable torch::Tensor stateTokens_;
+  mutable torch::Tensor stateTokenLength_;
 };
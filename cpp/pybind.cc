@@ -6,6 +6,7 @@
 #include "hanabi-learning-environment/hanabi_lib/hanabi_hand.h"
 #include "hanabi-learning-environment/hanabi_lib/hanabi_move.h"
 #include "hanabi-learning-environment/hanabi_lib/hanabi_observation.h"
+#include "hanabi-learning-environment/hanabi_lib/state_tokenizer.h"
 
 #include "cpp/hanabi_env.h"
 #include "cpp/thread_loop.h"
@@ -25,6 +26,7 @@ PYBIND11_MODULE(hanalearn, m) {
            int,  // maxLen
            bool>())
       .def("feature_size", &HanabiEnv::featureSize)
+      .def("binary_feature_size", &HanabiEnv::binaryFeatureSize)
       .def("num_action", &HanabiEnv::numAction)
       .def("reset", &HanabiEnv::reset)
       .def("reset_with_deck", &HanabiEnv::resetWithDeck)
@@ -44,7 +46,9 @@ PYBIND11_MODULE(hanalearn, m) {
       .def("get_obs_show_cards", &HanabiEnv::getObsShowCards)
       .def("get_last_action", &HanabiEnv::getLastAction)
       .def("get_step", &HanabiEnv::numStep)
-      .def("set_color_reward", &HanabiEnv::setColorReward);
+      .def("set_color_reward", &HanabiEnv::setColorReward)
+      .def("set_max_state_tokens", &HanabiEnv::setMaxStateTokens)
+      .def("max_state_tokens", &HanabiEnv::maxStateTokens);
 
   py::class_<R2D2Actor, std::shared_ptr<R2D2Actor>>(m, "R2D2Actor")
       .def(
@@ -157,6 +161,11 @@ PYBIND11_MODULE(hanalearn, m) {
     .value("Full", AuxType::Full);
 
   // m.def("observe", py::overload_cast<const hle::HanabiState&, int>(&observe));
+  // the log level of hanalearn, rela.set_log_level sets the one of rela
+  m.def("set_log_level", &rela::logging::setLevel);
+  m.def("get_log_level", &rela::logging::getLevel);
+  // tokenizer.json of HanabiState::ToTokenize, before the first actor runs
+  m.def("set_tokenizer_path", &SetTokenizerPath);
   m.def("get_last_non_deal_move", &getLastNonDealMove);
   m.def("get_last_non_deal_move_from_state", &getLastNonDealMoveFromState);
 
@@ -171,6 +180,14 @@ PYBIND11_MODULE(hanalearn, m) {
     .def(py::init<int, std::shared_ptr<rela::BatchRunner>, rela::TensorDict>())
     .def("set_llm_prior", &search::Player::setLLMPrior);
 
+  py::class_<HanabiEnvTasks, rela::TaskSet, std::shared_ptr<HanabiEnvTasks>>(
+      m, "HanabiEnvTasks")
+      .def(py::init<
+           std::vector<std::shared_ptr<HanabiEnv>>,
+           std::vector<std::vector<std::shared_ptr<R2D2Actor>>>,
+           bool>())
+      .def("reset", &HanabiEnvTasks::reset);
+
   py::class_<HanabiThreadLoop, rela::ThreadLoop, std::shared_ptr<HanabiThreadLoop>>(
       m, "HanabiThreadLoop")
       .def(py::init<
@@ -3,18 +3,8 @@
 #include <iomanip>
 #include <iostream>
 #include <fstream>
-#include <filesystem>
 #include <string>
 #include <vector>
-#include <tokenizers_cpp.h>
-using tokenizers::Tokenizer;
-
-
-std::string global_path = (std::filesystem::current_path() / "hanabi-learning-environment/hanabi_lib/dist/tokenizer.json").string();
-std::string global_data;
-int flag = 0;
-std::unique_ptr<Tokenizer> global_tok;
-
 
 std::vector<hle::HanabiCardValue> sampleCards(
     const std::vector<float>& v0,
@@ -277,18 +267,12 @@ std::unique_ptr<hle::HanabiMove> R2D2Actor::next(const HanabiEnv& env) {
   return nullptr;
 }
 void R2D2Actor::observeBeforeAct(const HanabiEnv& env) {
-  std::cout << "R2D2Actor::observeBeforeAct() - Player " << playerIdx_ << std::endl;
-  
+  RELA_TRACE("R2D2Actor::observeBeforeAct() player: " << playerIdx_);
+
   torch::NoGradGuard ng;
   prevHidden_ = hidden_;
-  std::vector<int> token_ids;
-  std::string result;
   const auto& state = env.getHleState();
-  result = state.ToText();
 
-  token_ids =  state.ToTokenize();
-
-  std::cout << "  Getting observation..." << std::endl;
   auto input = observe(
       state,
       playerIdx_,
@@ -298,9 +282,9 @@ void R2D2Actor::observeBeforeAct(const HanabiEnv& env) {
       hideAction_,
       aux_,
       sad_);
-  std::cout << "  Observation obtained" << std::endl;
-  
-  input["priv_s_text"] = torch::tensor(token_ids);
+
+  input["priv_s_text"] = env.getStateTokens();
+  input["priv_s_text_len"] = env.getStateTokenLength();
 
 
   // add features such as eps and temperature
@@ -345,26 +329,10 @@ void R2D2Actor::observeBeforeAct(const HanabiEnv& env) {
 
   addHid(input, hidden_);
   
-  std::cout << "  After addHid, input TensorDict size: " << input.size() << std::endl;
-  for (const auto& kv : input) {
-    std::cout << "    Key: " << kv.first << ", Shape: ";
-    if (kv.second.dim() == 0) {
-      std::cout << "scalar";
-    } else {
-      std::cout << "[";
-      for (int i = 0; i < kv.second.dim(); ++i) {
-        if (i > 0) std::cout << ", ";
-        std::cout << kv.second.size(i);
-      }
-      std::cout << "]";
-    }
-    std::cout << std::endl;
-  }
-  
-  std::cout << "  Calling BatchRunner with 'act' method..." << std::endl;
+  RELA_TRACE("  act input:\n" << rela::tensor_dict::shapeString(input, "    "));
+
   // no-blocking async call to neural network
-  futures_["act"] = runner_->call("act", input);
-  std::cout << "  BatchRunner call completed" << std::endl;
+  addFuture("act", runner_->call("act", input));
 
   if (replayBuffer_ == nullptr) {
     // eval mode, collect some stats
@@ -378,7 +346,6 @@ void R2D2Actor::observeBeforeAct(const HanabiEnv& env) {
   }
 
   if (!offBelief_) {
-    std::cout << "  observeBeforeAct completed (no off-belief)" << std::endl;
     return;
   }
 
@@ -398,11 +365,10 @@ void R2D2Actor::observeBeforeAct(const HanabiEnv& env) {
         rng_);
   } else {
     addHid(beliefInput, beliefHidden_);
-    futures_["belief"] = beliefRunner_->call("sample", beliefInput);
+    addFuture("belief", beliefRunner_->call("sample", beliefInput));
   }
 
   fictState_ = std::make_unique<hle::HanabiState>(state);
-  std::cout << "  observeBeforeAct completed (with off-belief)" << std::endl;
 }
 
 std::unique_ptr<hle::HanabiMove> R2D2Actor::decideMove(const HanabiEnv& env) {
@@ -422,47 +388,32 @@ std::unique_ptr<hle::HanabiMove> R2D2Actor::decideMove(const HanabiEnv& env) {
   //   auxReward_ = 0;
   // }
 
-  if (env.getCurrentPlayer() == playerIdx_ && reply.count("bp_logits") > 0) {
-    auto bp_logits = reply.at("bp_logits");
+  if (RELA_LOG_ON(rela::kDebug) && env.getCurrentPlayer() == playerIdx_ &&
+      reply.count("adv") > 0) {
     auto adv = reply.at("adv");
-    auto pikl_lambda = reply.at("pikl_lambda");
-    auto legal_adv = reply.at("legal_adv");
     auto legal_move = reply.at("legal_move");
+    bool pikl = reply.count("bp_logits") > 0;
 
-    // std::cout << "legal_adv: " << legal_adv.sizes() << std::endl;
-    std::cout << "@decideMove, step: " << env.numStep() << std::endl;
-    std::cout << "@decideMove last move: " << env.getMove(env.getLastAction()).ToString() << std::endl;
-    for (int action = 0; action < 20; ++action) {
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(4);
+    oss << "@decideMove, step: " << env.numStep() << "\n";
+    oss << "@decideMove last move: " << env.getMove(env.getLastAction()).ToString();
+    for (int action = 0; action < legal_move.size(0); ++action) {
       if (legal_move[action].item<int>() == 0) {
         continue;
       }
-      if (pikl_lambda.item<float>() == 0) {
+      if (pikl && reply.at("pikl_lambda").item<float>() == 0) {
         continue;
       }
-      std::cout << std::fixed;
-      std::cout << std::setprecision(4)
-                << "@decideMove action: " << env.getMove(action).ToString()
-                << ", adv: " << adv[action].item<float>()
-                << ", bp_logits: " << bp_logits[action].item<float>()
-                << ", final_adv: " << legal_adv[action].item<float>() << std::endl;
-    }
-    std::cout << "---------------------------------" << std::endl;
-  } else if (env.getCurrentPlayer() == playerIdx_ && reply.count("adv") > 0) {
-    std::cout << "@decideMove, step: " << env.numStep() << std::endl;
-    auto adv = reply.at("adv");
-    auto legal_move = reply.at("legal_move");
-
-    std::cout << "@decideMove last move: " << env.getMove(env.getLastAction()).ToString() << std::endl;
-    for (int action = 0; action < 20; ++action) {
-      if (legal_move[action].item<int>() == 0) {
-        continue;
+      oss << "\n@decideMove action: " << env.getMove(action).ToString()
+          << ", adv: " << adv[action].item<float>();
+      if (pikl) {
+        oss << ", bp_logits: " << reply.at("bp_logits")[action].item<float>()
+            << ", final_adv: " << reply.at("legal_adv")[action].item<float>();
       }
-      std::cout << std::fixed;
-      std::cout << std::setprecision(4)
-                << "@decideMove action: " << env.getMove(action).ToString()
-                << ", adv: " << adv[action].item<float>() << std::endl;
     }
-    std::cout << "---------------------------------" << std::endl;
+    oss << "\n---------------------------------";
+    RELA_DEBUG(oss.str());
   }
 
   if (replayBuffer_ != nullptr) {
@@ -544,7 +495,7 @@ std::unique_ptr<hle::HanabiMove> R2D2Actor::decideMove(const HanabiEnv& env) {
         partnerInput["temperature"] = torch::tensor(partner->playerTemp_);
       }
       addHid(partnerInput, partner->prevHidden_);
-      futures_["fict_act"] = partner->runner_->call("act", partnerInput);
+      addFuture("fict_act", partner->runner_->call("act", partnerInput));
     }
   }
   return move;
@@ -584,7 +535,7 @@ void R2D2Actor::fictAct(const HanabiEnv& env) {
     fictInput["temperature"] = torch::tensor(playerTemp_);
   }
 
-  futures_["target"] = runner_->call("compute_target", fictInput);
+  addFuture("target", runner_->call("compute_target", fictInput));
 }
 
 void R2D2Actor::observeAfterAct(const HanabiEnv& env) {
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "rela/batch_runner.h"
+#include "rela/logging.h"
 #include "rela/replay.h"
 #include "rela/r2d2.h"
 
@@ -97,6 +98,12 @@ class R2D2Actor {
 
   void reset(const HanabiEnv& env);
 
+  // push tag onto queue whenever one of our replies arrives
+  void setReadyQueue(std::shared_ptr<rela::ReadyQueue> queue, int tag) {
+    readyQueue_ = std::move(queue);
+    readyTag_ = tag;
+  }
+
   bool ready() const;
 
   bool stepDone() const;
@@ -134,32 +141,22 @@ class R2D2Actor {
 
  private:
   rela::TensorDict getH0(int numPlayer, std::shared_ptr<rela::BatchRunner>& runner) {
-    std::cout << "    R2D2Actor::getH0() - numPlayer: " << numPlayer << std::endl;
     std::vector<torch::jit::IValue> input{numPlayer};
-    std::cout << "    Calling JIT model get_h0 method..." << std::endl;
     auto model = runner->jitModel();
     auto output = model.get_method("get_h0")(input);
-    std::cout << "    Converting get_h0 output from IValue..." << std::endl;
     auto h0 = rela::tensor_dict::fromIValue(output, torch::kCPU, true);
-    std::cout << "    getH0 result size: " << h0.size() << std::endl;
-    for (const auto& kv : h0) {
-      std::cout << "      Key: " << kv.first << ", Shape: ";
-      if (kv.second.dim() == 0) {
-        std::cout << "scalar";
-      } else {
-        std::cout << "[";
-        for (int i = 0; i < kv.second.dim(); ++i) {
-          if (i > 0) std::cout << ", ";
-          std::cout << kv.second.size(i);
-        }
-        std::cout << "]";
-      }
-      std::cout << std::endl;
-    }
-    std::cout << "    getH0 completed successfully" << std::endl;
+    RELA_DEBUG("R2D2Actor::getH0() numPlayer: " << numPlayer << "\n"
+               << rela::tensor_dict::shapeString(h0, "  "));
     return h0;
   }
 
+  void addFuture(const std::string& key, rela::FutureReply fut) {
+    if (readyQueue_ != nullptr) {
+      fut.notifyOnReady(readyQueue_, readyTag_);
+    }
+    futures_[key] = std::move(fut);
+  }
+
   void observeBeforeAct(const HanabiEnv& env);
 
   std::unique_ptr<hle::HanabiMove> decideMove(const HanabiEnv& env);
@@ -214,6 +211,8 @@ class R2D2Actor {
   // to control stages
   Stage stage_ = Stage::ObserveBeforeAct;
   std::unordered_map<std::string, rela::FutureReply> futures_;
+  std::shared_ptr<rela::ReadyQueue> readyQueue_;
+  int readyTag_ = -1;
 
   // information on cards played
   // only computed during eval mode (replayBuffer==nullptr)
@@ -52,17 +52,16 @@ void R2D2ActorSimple::reset(const HanabiEnv& env) {
 
 // Returns optional move and whether we're done acting
 std::unique_ptr<hle::HanabiMove> R2D2ActorSimple::next(const HanabiEnv& env) {
-  std::cout << "R2D2ActorSimple::next() - Player " << playerIdx_ << ", Stage: ";
-  
+  RELA_TRACE("R2D2ActorSimple::next() player: " << playerIdx_
+             << ", stage: " << (int)stage_);
+
   if (stage_ == Stage::ObserveBeforeAct) {
-    std::cout << "ObserveBeforeAct" << std::endl;
     observeBeforeAct(env);
     stage_ = Stage::DecideMove;
     return nullptr;
   }
 
   if (stage_ == Stage::DecideMove) {
-    std::cout << "DecideMove" << std::endl;
     auto move = decideMove(env);
     if (offBelief_) {
       stage_ = Stage::FictAct;
@@ -73,14 +72,12 @@ std::unique_ptr<hle::HanabiMove> R2D2ActorSimple::next(const HanabiEnv& env) {
   }
 
   if (stage_ == Stage::FictAct) {
-    std::cout << "FictAct" << std::endl;
     fictAct(env);
     stage_ = Stage::ObserveAfterAct;
     return nullptr;
   }
 
   if (stage_ == Stage::ObserveAfterAct) {
-    std::cout << "ObserveAfterAct" << std::endl;
     observeAfterAct(env);
     if (env.terminated()) {
       stage_ = Stage::StoreTrajectory;
@@ -91,29 +88,23 @@ std::unique_ptr<hle::HanabiMove> R2D2ActorSimple::next(const HanabiEnv& env) {
   }
 
   if (stage_ == Stage::StoreTrajectory) {
-    std::cout << "StoreTrajectory" << std::endl;
     storeTrajectory(env);
     stage_ = Stage::ObserveBeforeAct;
     return nullptr;
   }
 
-  std::cout << "Unknown stage!" << std::endl;
+  RELA_ERROR("R2D2ActorSimple::next() unknown stage " << (int)stage_);
   assert(false);
   return nullptr;
 }
 
 void R2D2ActorSimple::observeBeforeAct(const HanabiEnv& env) {
-  std::cout << "R2D2ActorSimple::observeBeforeAct() - Player " << playerIdx_ << std::endl;
-  
+  RELA_TRACE("R2D2ActorSimple::observeBeforeAct() player: " << playerIdx_);
+
   torch::NoGradGuard ng;
   prevHidden_ = hidden_;
-  std::vector<int> token_ids;
-  std::string result;
   const auto& state = env.getHleState();
-  result = state.ToText();
-  token_ids = state.ToTokenize();
 
-  std::cout << "  Getting observation..." << std::endl;
   auto input = observe(
       state,
       playerIdx_,
@@ -123,9 +114,9 @@ void R2D2ActorSimple::observeBeforeAct(const HanabiEnv& env) {
       hideAction_,
       aux_,
       sad_);
-  std::cout << "  Observation obtained" << std::endl;
-  
-  input["priv_s_text"] = torch::tensor(token_ids);
+
+  input["priv_s_text"] = env.getStateTokens();
+  input["priv_s_text_len"] = env.getStateTokenLength();
 
   // add features such as eps and temperature
   if (epsList_.size()) {
@@ -160,26 +151,8 @@ void R2D2ActorSimple::observeBeforeAct(const HanabiEnv& env) {
 
   addHid(input, hidden_);
   
-  std::cout << "  After addHid, input TensorDict size: " << input.size() << std::endl;
-  for (const auto& kv : input) {
-    std::cout << "    Key: " << kv.first << ", Shape: ";
-    if (kv.second.dim() == 0) {
-      std::cout << "scalar";
-    } else {
-      std::cout << "[";
-      for (int i = 0; i < kv.second.dim(); ++i) {
-        if (i > 0) std::cout << ", ";
-        std::cout << kv.second.size(i);
-      }
-      std::cout << "]";
-    }
-    std::cout << std::endl;
-  }
-  
-  std::cout << "  Calling model with 'act' method..." << std::endl;
   // Direct synchronous call to neural network
   auto reply = callModel("act", input);
-  std::cout << "  Model call completed" << std::endl;
 
   // Store reply for decideMove
   actReply_ = reply;
@@ -194,7 +167,6 @@ void R2D2ActorSimple::observeBeforeAct(const HanabiEnv& env) {
     privV0, env.getHleGame(), obs.Hands()[0].Cards().size());
 
   if (!offBelief_) {
-    std::cout << "  observeBeforeAct completed (no off-belief)" << std::endl;
     return;
   }
 
@@ -216,7 +188,6 @@ void R2D2ActorSimple::observeBeforeAct(const HanabiEnv& env) {
   //     rng_);
 
   fictState_ = std::make_unique<hle::HanabiState>(state);
-  std::cout << "  observeBeforeAct completed (with off-belief)" << std::endl;
 }
 
 std::unique_ptr<hle::HanabiMove> R2D2ActorSimple::decideMove(const HanabiEnv& env) {
@@ -227,46 +198,32 @@ std::unique_ptr<hle::HanabiMove> R2D2ActorSimple::decideMove(const HanabiEnv& en
   int action = reply.at("a").item<int64_t>();
   moveHid(reply, hidden_);
 
-  if (env.getCurrentPlayer() == playerIdx_ && reply.count("bp_logits") > 0) {
-    auto bp_logits = reply.at("bp_logits");
+  if (RELA_LOG_ON(rela::kDebug) && env.getCurrentPlayer() == playerIdx_ &&
+      reply.count("adv") > 0) {
     auto adv = reply.at("adv");
-    auto pikl_lambda = reply.at("pikl_lambda");
-    auto legal_adv = reply.at("legal_adv");
     auto legal_move = reply.at("legal_move");
+    bool pikl = reply.count("bp_logits") > 0;
 
-    std::cout << "@decideMove, step: " << env.numStep() << std::endl;
-    std::cout << "@decideMove last move: " << env.getMove(env.getLastAction()).ToString() << std::endl;
-    for (int action = 0; action < 20; ++action) {
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(4);
+    oss << "@decideMove, step: " << env.numStep() << "\n";
+    oss << "@decideMove last move: " << env.getMove(env.getLastAction()).ToString();
+    for (int action = 0; action < legal_move.size(0); ++action) {
       if (legal_move[action].item<int>() == 0) {
         continue;
       }
-      if (pikl_lambda.item<float>() == 0) {
+      if (pikl && reply.at("pikl_lambda").item<float>() == 0) {
         continue;
       }
-      std::cout << std::fixed;
-      std::cout << std::setprecision(4)
-                << "@decideMove action: " << env.getMove(action).ToString()
-                << ", adv: " << adv[action].item<float>()
-                << ", bp_logits: " << bp_logits[action].item<float>()
-                << ", final_adv: " << legal_adv[action].item<float>() << std::endl;
-    }
-    std::cout << "---------------------------------" << std::endl;
-  } else if (env.getCurrentPlayer() == playerIdx_ && reply.count("adv") > 0) {
-    std::cout << "@decideMove, step: " << env.numStep() << std::endl;
-    auto adv = reply.at("adv");
-    auto legal_move = reply.at("legal_move");
-
-    std::cout << "@decideMove last move: " << env.getMove(env.getLastAction()).ToString() << std::endl;
-    for (int action = 0; action < 20; ++action) {
-      if (legal_move[action].item<int>() == 0) {
-        continue;
+      oss << "\n@decideMove action: " << env.getMove(action).ToString()
+          << ", adv: " << adv[action].item<float>();
+      if (pikl) {
+        oss << ", bp_logits: " << reply.at("bp_logits")[action].item<float>()
+            << ", final_adv: " << reply.at("legal_adv")[action].item<float>();
       }
-      std::cout << std::fixed;
-      std::cout << std::setprecision(4)
-                << "@decideMove action: " << env.getMove(action).ToString()
-                << ", adv: " << adv[action].item<float>() << std::endl;
     }
-    std::cout << "---------------------------------" << std::endl;
+    oss << "\n---------------------------------";
+    RELA_DEBUG(oss.str());
   }
 
   // get the real action
@@ -7,6 +7,7 @@
 #include "cpp/hanabi_env.h"
 #include "cpp/utils.h"
 #include "cpp/r2d2_actor_utils.h"
+#include "rela/logging.h"
 
 namespace py = pybind11;
 
@@ -111,93 +112,48 @@ class R2D2ActorSimple {
  private:
   // Direct model call without rela
   rela::TensorDict callModel(const std::string& method, const rela::TensorDict& input) {
-    std::cout << "    R2D2ActorSimple::callModel() - Method: " << method << std::endl;
-    std::cout << "    Input TensorDict size: " << input.size() << std::endl;
-    for (const auto& kv : input) {
-      std::cout << "      Key: " << kv.first << ", Shape: ";
-      if (kv.second.dim() == 0) {
-        std::cout << "scalar";
-      } else {
-        std::cout << "[";
-        for (int i = 0; i < kv.second.dim(); ++i) {
-          if (i > 0) std::cout << ", ";
-          std::cout << kv.second.size(i);
-        }
-        std::cout << "]";
-      }
-      std::cout << std::endl;
-    }
-    
+    RELA_TRACE("R2D2ActorSimple::callModel() method: " << method << "\n"
+               << rela::tensor_dict::shapeString(input, "  "));
+
     torch::NoGradGuard ng;
-    
+
     // Convert to batch format like BatchRunner does
     rela::TensorDict batchInput;
     for (const auto& kv : input) {
       // Add batch dimension (unsqueeze at dim 0)
       batchInput[kv.first] = kv.second.unsqueeze(0);
     }
-    
-    std::cout << "    Converting batch input to IValue..." << std::endl;
+
     std::vector<torch::jit::IValue> ivalues;
     ivalues.push_back(rela::tensor_dict::toIValue(batchInput, torch::kCPU));
-    std::cout << "    IValue vector size: " << ivalues.size() << std::endl;
-    std::cout << "    Calling JIT model method: " << method << std::endl;
-    
+
     try {
       auto output = jitModel_->get_method(method)(ivalues);
-      std::cout << "    Converting output from IValue..." << std::endl;
       auto batchResult = rela::tensor_dict::fromIValue(output, torch::kCPU, true);
-      
+
       // Remove batch dimension (squeeze at dim 0) to get single sample result
       rela::TensorDict result;
       for (const auto& kv : batchResult) {
         result[kv.first] = kv.second.squeeze(0);
       }
-      
-      std::cout << "    callModel completed successfully" << std::endl;
       return result;
     } catch (const std::exception& e) {
-      std::cout << "    ERROR in callModel: " << e.what() << std::endl;
-      std::cout << "    Trying to get model method signature..." << std::endl;
-      
-      // Try to get method signature for debugging
-      try {
-        auto method_obj = jitModel_->get_method(method);
-        std::cout << "    Method object obtained successfully" << std::endl;
-      } catch (const std::exception& e2) {
-        std::cout << "    ERROR getting method: " << e2.what() << std::endl;
-      }
-      
+      RELA_ERROR("R2D2ActorSimple::callModel() method " << method << " failed: "
+                 << e.what() << "\n" << rela::tensor_dict::shapeString(input, "  "));
       throw;
     } catch (...) {
-      std::cout << "    ERROR in callModel: Unknown exception" << std::endl;
+      RELA_ERROR("R2D2ActorSimple::callModel() method " << method
+                 << " failed with unknown exception");
       throw;
     }
   }
 
   rela::TensorDict getH0(int numPlayer) {
-    std::cout << "    R2D2ActorSimple::getH0() - numPlayer: " << numPlayer << std::endl;
     std::vector<torch::jit::IValue> input{numPlayer};
-    std::cout << "    Calling JIT model get_h0 method..." << std::endl;
     auto output = jitModel_->get_method("get_h0")(input);
-    std::cout << "    Converting get_h0 output from IValue..." << std::endl;
     auto result = rela::tensor_dict::fromIValue(output, torch::kCPU, true);
-    std::cout << "    getH0 result size: " << result.size() << std::endl;
-    for (const auto& kv : result) {
-      std::cout << "      Key: " << kv.first << ", Shape: ";
-      if (kv.second.dim() == 0) {
-        std::cout << "scalar";
-      } else {
-        std::cout << "[";
-        for (int i = 0; i < kv.second.dim(); ++i) {
-          if (i > 0) std::cout << ", ";
-          std::cout << kv.second.size(i);
-        }
-        std::cout << "]";
-      }
-      std::cout << std::endl;
-    }
-    std::cout << "    getH0 completed successfully" << std::endl;
+    RELA_DEBUG("R2D2ActorSimple::getH0() numPlayer: " << numPlayer << "\n"
+               << rela::tensor_dict::shapeString(result, "  "));
     return result;
   }
 
@@ -1,74 +1,107 @@
+#include <numeric>
+
 #include "thread_loop.h"
 
 void HanabiThreadLoop::mainLoop() {
+  // visit every env once, then only the envs whose replies arrived or that
+  // made progress in their previous visit
+  std::vector<int> toVisit(tasks_.size());
+  std::iota(toVisit.begin(), toVisit.end(), 0);
+  std::vector<int> visiting;
+  std::vector<int8_t> inVisit(tasks_.size(), 0);
+
   while (!terminated()) {
-    // go over each envs in sequential order
+    if (toVisit.empty()) {
+      // block until a reply arrives, wake up regularly to check terminated()
+      readyQueue_->popAll(toVisit, std::chrono::milliseconds(100));
+    } else {
+      readyQueue_->popAll(toVisit, std::chrono::milliseconds(0));
+    }
+
+    visiting.clear();
+    for (int i : toVisit) {
+      // the same env may be reported by several replies
+      if (!inVisit[i]) {
+        inVisit[i] = 1;
+        visiting.push_back(i);
+      }
+    }
+    toVisit.clear();
+    for (int i : visiting) {
+      inVisit[i] = 0;
+    }
+
     // call in seperate for-loops to maximize parallization
-    for (size_t i = 0; i < envs_.size(); ++i) {
+    for (int i : visiting) {
       if (paused()) {
         waitUntilResume();
       }
 
-      if (done_[i] == 1) {
-        continue;
+      if (tasks_.step(i)) {
+        toVisit.push_back(i);
+      }
+      if (tasks_.finished()) {
+        return;
       }
+    }
+  }
+}
 
-      assert(done_[i] < 1);
-      auto& actors = actors_[i];
+bool HanabiEnvTasks::step(int i) {
+  if (done_[i] == 1) {
+    return false;
+  }
 
-      // only check if game terminates and whether to
-      // reset the game & actor if the all actor has
-      // finished their tasks with the current game step
-      bool allActorDone = true;
-      for (auto& actor : actors) {
-        if (!actor->stepDone()) {
-          allActorDone = false;
-        }
-      }
-      if (allActorDone && envs_[i]->terminated()) {
-        if (eval_) {
-          // we only run 1 game for evaluation. done[i] is initially
-          // -1, and become 0 when we start the first game.
-          ++done_[i];
-          if (done_[i] == 1) {
-            numDone_ += 1;
-            if (numDone_ == (int)envs_.size()) {
-              return;
-            } else {
-              continue;
-            }
-          }
-        }
+  assert(done_[i] < 1);
+  auto& actors = actors_[i];
 
-        envs_[i]->reset();
-        for (size_t j = 0; j < actors.size(); ++j) {
-          actors[j]->reset(*envs_[i]);
-        }
+  // only check if game terminates and whether to
+  // reset the game & actor if the all actor has
+  // finished their tasks with the current game step
+  bool allActorDone = true;
+  for (auto& actor : actors) {
+    if (!actor->stepDone()) {
+      allActorDone = false;
+    }
+  }
+  if (allActorDone && envs_[i]->terminated()) {
+    if (eval_) {
+      // we only run 1 game for evaluation. done[i] is initially
+      // -1, and become 0 when we start the first game.
+      ++done_[i];
+      if (done_[i] == 1) {
+        numDone_ += 1;
+        return false;
       }
+    }
 
-      bool allActorReady = true;
-      for (auto& actor : actors) {
-        if (!actor->ready()) {
-          allActorReady = false;
-        }
-      }
-      if (!allActorReady) {
-        // we want to keep sync between actors in a same game
-        continue;
-      }
+    envs_[i]->reset();
+    for (size_t j = 0; j < actors.size(); ++j) {
+      actors[j]->reset(*envs_[i]);
+    }
+  }
 
-      std::vector<std::unique_ptr<hle::HanabiMove>> moves;
-      for (auto& actor : actors) {
-        moves.push_back(actor->next(*envs_[i]));
-      }
-      if (!envs_[i]->terminated()) {
-        // std::cout << "cur player?: " << envs_[i]->getCurrentPlayer() << std::endl;
-        auto& move = moves[envs_[i]->getCurrentPlayer()];
-        if (move != nullptr) {
-          // std::cout << "move: " << move->ToString() << std::endl;
-          envs_[i]->step(*move);
-        }
-      }
+  bool allActorReady = true;
+  for (auto& actor : actors) {
+    if (!actor->ready()) {
+      allActorReady = false;
+    }
+  }
+  if (!allActorReady) {
+    // we want to keep sync between actors in a same game,
+    // the pending reply will put this env back in the ready queue
+    return false;
+  }
+
+  std::vector<std::unique_ptr<hle::HanabiMove>> moves;
+  for (auto& actor : actors) {
+    moves.push_back(actor->next(*envs_[i]));
+  }
+  if (!envs_[i]->terminated()) {
+    auto& move = moves[envs_[i]->getCurrentPlayer()];
+    if (move != nullptr) {
+      envs_[i]->step(*move);
     }
   }
+  return true;
 }
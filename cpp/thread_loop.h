@@ -1,11 +1,14 @@
 #pragma once
 
 #include "cpp/r2d2_actor.h"
+#include "rela/ready_queue.h"
 #include "rela/thread_loop.h"
+#include "rela/work_stealing.h"
 
-class HanabiThreadLoop : public rela::ThreadLoop {
+// envs and their actors as a rela::TaskSet, one task per env
+class HanabiEnvTasks : public rela::TaskSet {
  public:
-  HanabiThreadLoop(
+  HanabiEnvTasks(
       std::vector<std::shared_ptr<HanabiEnv>> envs,
       std::vector<std::vector<std::shared_ptr<R2D2Actor>>> actors,
       bool eval)
@@ -16,7 +19,26 @@ class HanabiThreadLoop : public rela::ThreadLoop {
     assert(envs_.size() == actors_.size());
   }
 
-  virtual void mainLoop() override;
+  virtual int size() const override {
+    return (int)envs_.size();
+  }
+
+  virtual void setReadyQueue(std::shared_ptr<rela::ReadyQueue> queue) override {
+    for (size_t i = 0; i < actors_.size(); ++i) {
+      for (auto& actor : actors_[i]) {
+        actor->setReadyQueue(queue, (int)i);
+      }
+    }
+  }
+
+  // advance env i by one step if all its actors are ready. returns true if
+  // it did, false if it waits for a reply (which will push i onto the
+  // ready queue) or is done
+  virtual bool step(int i) override;
+
+  virtual bool finished() const override {
+    return eval_ && numDone_ == (int)envs_.size();
+  }
 
   void reset() {
     assert(eval_); // reset is only for the eval mode
@@ -36,5 +58,29 @@ class HanabiThreadLoop : public rela::ThreadLoop {
   std::vector<std::vector<std::shared_ptr<R2D2Actor>>> actors_;
   std::vector<int8_t> done_;
   const bool eval_;
-  int numDone_ = 0;
+  // envs may be stepped by several workers
+  std::atomic<int> numDone_{0};
+};
+
+// runs a fixed slice of envs on one thread
+class HanabiThreadLoop : public rela::ThreadLoop {
+ public:
+  HanabiThreadLoop(
+      std::vector<std::shared_ptr<HanabiEnv>> envs,
+      std::vector<std::vector<std::shared_ptr<R2D2Actor>>> actors,
+      bool eval)
+      : tasks_(std::move(envs), std::move(actors), eval)
+      , readyQueue_(std::make_shared<rela::ReadyQueue>()) {
+    tasks_.setReadyQueue(readyQueue_);
+  }
+
+  virtual void mainLoop() override;
+
+  void reset() {
+    tasks_.reset();
+  }
+
+ private:
+  HanabiEnvTasks tasks_;
+  std::shared_ptr<rela::ReadyQueue> readyQueue_;
 };
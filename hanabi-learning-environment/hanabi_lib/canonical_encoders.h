@@ -92,6 +92,8 @@ class CanonicalObservationEncoder : public ObservationEncoder {
 
 int LastActionSectionLength(const HanabiGame& game);
 
+int CardKnowledgeSectionLength(const HanabiGame& game);
+
 std::vector<int> ComputeCardCount(
     const HanabiGame& game,
     const HanabiObservation& obs,
@@ -15,9 +15,9 @@
 #include "hanabi_state.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <numeric>
-#include <tokenizers_cpp.h>
 
 #include <cassert>
 #include <chrono>
@@ -28,10 +28,10 @@
 #include <vector>
 #include <thread>
 #include <mutex>
+#include "state_text.h"
+#include "state_tokenizer.h"
 #include "util.h"
 
-using tokenizers::Tokenizer;
-
 
 namespace hanabi_learning_env {
 
@@ -392,135 +392,32 @@ std::string HanabiState::ToString() const {
 
 std::string HanabiState::ToText() const {
   std::string result;
-  std::string hand_info;
-  std::string knowledge_info;
-  std::string path;
-  int counter;
-  result +=  std::to_string(InformationTokens()) + " clue tokens available. ";
-
-  result += std::to_string(LifeTokens())  + " life tokens remaining. ";
-
-  result += "fireworks display: ";
-  for (int i = 0; i < ParentGame()->NumColors(); ++i) {
-    result += convertColorInitial(ColorIndexToChar(i)) + " ";
-    result += std::to_string(fireworks_[i]) + " ";
-  }
-
-  for (int i = 0; i < hands_.size(); ++i) {
-    if (i == CurPlayer()) {
-          result += ". knowledge about own hand: " ;
-          for (int j = 0;j<5;++j) {
-            knowledge_info = hands_[i].Knowledge()[j].ToString();
-            result += convertColorInitial(knowledge_info[0]) + " ";
-            result += ((knowledge_info[1] == 'X') ? "Unknown" : std::string(1, knowledge_info[1])) + " ";
-          }
-        }
-  }
-  counter = 1;
-  for (int i = 0; i < hands_.size(); ++i) {
-
-    if (i != CurPlayer()) {
-      result += ". Player +"+ std::to_string(counter) +" hand: " ;
-      for (int j = 0;j<5;++j) {
-        hand_info =  hands_[i].Cards()[j].ToString();
-        result+=  convertColorInitial( hand_info[hand_info.find(' ') + 1]) + " " + hand_info.back()+" " ;
-      }
-
-
-      result += ". Player +"+std::to_string(counter) +" revealed information: " ;
-      for (int k = 0;k<5;++k) {
-        knowledge_info = hands_[i].Knowledge()[k].ToString();
-        result += convertColorInitial(knowledge_info[0]) + " ";
-        result += ((knowledge_info[1] == 'X') ? "Unknown" : std::string(1, knowledge_info[1])) + " ";
-      }
-      counter+= 1;
-    }
-  }
-  result =result+'.';
+  AppendStateText(*this, false, &result);
   return result;
 }
 
-
-std::unique_ptr<Tokenizer> load_tokenizer() {
-  auto path = "../hanabi-learning-environment/hanabi_lib/dist/tokenizer.json";
-  std::ifstream fs(path, std::ios::in | std::ios::binary);
-  if (fs.fail()) {
-    std::cerr << "Cannot open " << path << std::endl;
-    exit(1);
-  }
-  std::string data;
-  fs.seekg(0, std::ios::end);
-  size_t size = static_cast<size_t>(fs.tellg());
-  fs.seekg(0, std::ios::beg);
-  data.resize(size);
-  fs.read(data.data(), size);
-  std::cout << "Loaded Tokenizer - " << std::endl;
-  return std::move(Tokenizer::FromBlobJSON(data));
-}
-thread_local std::unique_ptr<Tokenizer> private_tok = load_tokenizer();
-
-void initialize_tokenizer() {
-    static std::once_flag flag;
-    std::call_once(flag, []() {
-        private_tok = load_tokenizer();
-    });
-    if (!private_tok) {
-        private_tok = load_tokenizer();
-    }
-}
-
-std::vector<int>  HanabiState::ToTokenize() const {
+std::string HanabiState::ToTokenizeText() const {
   std::string result;
-  std::string hand_info;
-  std::string knowledge_info;
-  std::string path;
-  int counter;
-  initialize_tokenizer();
-  result += std::to_string(ParentGame()->NumPlayers()) + " player game. ";
-  result +=  std::to_string(InformationTokens()) + " clue tokens available. ";
-
-  result += std::to_string(LifeTokens())  + " life tokens remaining. ";
-
-  result += "fireworks display: ";
-  for (int i = 0; i < ParentGame()->NumColors(); ++i) {
-    result += convertColorInitial(ColorIndexToChar(i)) + " ";
-    result += std::to_string(fireworks_[i]) + " ";
-  }
-
-  for (int i = 0; i < hands_.size(); ++i) {
-    if (i == CurPlayer()) {
-          result += ". knowledge about own hand: " ;
-          for (int j = 0;j<5;++j) {
-            knowledge_info = hands_[i].Knowledge()[j].ToString();
-            result += convertColorInitial(knowledge_info[0]) + " ";
-            result += ((knowledge_info[1] == 'X') ? "Unknown" : std::string(1, knowledge_info[1])) + " ";
-          }
-        }
-  }
-  counter = 1;
-  for (int i = 0; i < hands_.size(); ++i) {
-
-    if (i != CurPlayer()) {
-      result += ". Player +"+ std::to_string(counter) +" hand: " ;
-      for (int j = 0;j<5;++j) {
-        hand_info =  hands_[i].Cards()[j].ToString();
-        result+=  convertColorInitial( hand_info[hand_info.find(' ') + 1]) + " " + hand_info.back()+" " ;
-      }
-
+  AppendStateText(*this, true, &result);
+  return result;
+}
 
-      result += ". Player +"+std::to_string(counter) +" revealed information: " ;
-      for (int k = 0;k<5;++k) {
-        knowledge_info = hands_[i].Knowledge()[k].ToString();
-        result += convertColorInitial(knowledge_info[0]) + " ";
-        result += ((knowledge_info[1] == 'X') ? "Unknown" : std::string(1, knowledge_info[1])) + " ";
-      }
-      counter+= 1;
+std::vector<int> HanabiState::ToTokenize(int max_tokens, int* length) const {
+  assert(max_tokens > 0);
+  std::vector<int> ids;
+  ids.reserve(max_tokens);
+  SharedStateTokenizer().Tokenize(*this, &ids);
+  if (ids.size() > static_cast<size_t>(max_tokens)) {
+    static std::atomic<bool> warned{false};
+    if (!warned.exchange(true)) {
+      std::cerr << "Warning: state text of " << ids.size()
+                << " tokens truncated to " << max_tokens << std::endl;
     }
   }
-  result =result+'.';
-
-  std::vector<int> ids = private_tok->Encode(result);
-  ids.resize(196, 0);
+  if (length != nullptr) {
+    *length = std::min<int>(ids.size(), max_tokens);
+  }
+  ids.resize(max_tokens, 0);
   return ids;
 }
 
@@ -139,8 +139,18 @@ class HanabiState {
   int Score() const;
   int MaxPossibleScore() const;
   std::string ToString() const;
+  // Text description of the state from the view of the current player, see
+  // RenderState(). AppendStateText() fills a reusable buffer instead.
   std::string ToText() const;
-  std::vector<int> ToTokenize() const;
+  // Text tokenized by ToTokenize(), ToText() with the number of players in
+  // front. ToTokenize() emits its token ids without building it, see
+  // StateTokenizer.
+  std::string ToTokenizeText() const;
+  // Token ids padded with 0 or truncated to exactly max_tokens. If length
+  // is not null, it receives the number of ids before the padding.
+  std::vector<int> ToTokenize(int max_tokens = kDefaultMaxTokens,
+                              int* length = nullptr) const;
+  static constexpr int kDefaultMaxTokens = 196;
   std::string ToStringBasic() const;
 
 
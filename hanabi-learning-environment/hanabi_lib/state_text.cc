@@ -0,0 +1,68 @@
+#include "state_text.h"
+
+#include <cassert>
+
+#include "util.h"
+
+namespace hanabi_learning_env {
+
+const char* const kStatePhraseText[kNumStatePhrases] = {
+    " player game. ",
+    " clue tokens available. ",
+    " life tokens remaining. ",
+    "fireworks display: ",
+    ". knowledge about own hand: ",
+    ". Player +",
+    " hand: ",
+    " revealed information: ",
+    ".",
+};
+
+const char* StateColorText(int color) {
+  static const char* const kColors[kMaxNumColors] = {"Red", "Yellow", "Green",
+                                                     "White", "Blue"};
+  return color >= 0 && color < kMaxNumColors ? kColors[color] : "Unknown";
+}
+
+const char* StateRankText(int rank) {
+  static const char* const kRanks[kMaxNumRanks] = {"1", "2", "3", "4", "5"};
+  return rank >= 0 && rank < kMaxNumRanks ? kRanks[rank] : "Unknown";
+}
+
+namespace {
+
+class TextSink {
+ public:
+  explicit TextSink(std::string* text) : text_(text) {}
+
+  void Phrase(StatePhrase phrase) { text_->append(kStatePhraseText[phrase]); }
+  void Number(int n) {
+    // numbers in the text are small and non negative
+    assert(n >= 0);
+    char digits[12];
+    int len = 0;
+    do {
+      digits[len++] = '0' + n % 10;
+      n /= 10;
+    } while (n > 0);
+    while (len > 0) {
+      text_->push_back(digits[--len]);
+    }
+  }
+  void Color(int color) { text_->append(StateColorText(color)); }
+  void Rank(int rank) { text_->append(StateRankText(rank)); }
+  void Separator() { text_->push_back(' '); }
+
+ private:
+  std::string* text_;
+};
+
+}  // namespace
+
+void AppendStateText(const HanabiState& state, bool with_num_players,
+                     std::string* text) {
+  TextSink sink(text);
+  RenderState(state, with_num_players, &sink);
+}
+
+}  // namespace hanabi_learning_env
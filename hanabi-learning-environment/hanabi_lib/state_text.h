@@ -0,0 +1,107 @@
+#ifndef __STATE_TEXT_H__
+#define __STATE_TEXT_H__
+
+#include <string>
+
+#include "hanabi_state.h"
+
+namespace hanabi_learning_env {
+
+// Fixed phrases of the state text.
+enum StatePhrase {
+  kPlayerGamePhrase,
+  kClueTokensPhrase,
+  kLifeTokensPhrase,
+  kFireworksPhrase,
+  kOwnHandPhrase,
+  kPlayerPhrase,
+  kHandPhrase,
+  kRevealedPhrase,
+  kEndPhrase,
+  kNumStatePhrases
+};
+
+// Text of each StatePhrase, with the spaces and punctuation around it.
+extern const char* const kStatePhraseText[kNumStatePhrases];
+
+// Word for a color or rank index, "Unknown" for -1.
+const char* StateColorText(int color);
+const char* StateRankText(int rank);
+
+// Walks the text description of state from the view of the current player
+// and hands it to sink piece by piece, in text order:
+//   sink->Phrase(StatePhrase)
+//   sink->Number(int)
+//   sink->Color(int), sink->Rank(int)  index, or -1 if not hinted
+//   sink->Separator()                  a space between two words
+// Works for any number of players and hand size. With with_num_players the
+// text starts with "<n> player game. ", as in HanabiState::ToTokenizeText().
+template <typename Sink>
+void RenderState(const HanabiState& state, bool with_num_players, Sink* sink) {
+  auto knowledge = [sink](const HanabiHand::CardKnowledge& card) {
+    sink->Color(card.ColorHinted() ? card.Color() : -1);
+    sink->Separator();
+    sink->Rank(card.RankHinted() ? card.Rank() : -1);
+    sink->Separator();
+  };
+
+  const HanabiGame* game = state.ParentGame();
+  if (with_num_players) {
+    sink->Number(game->NumPlayers());
+    sink->Phrase(kPlayerGamePhrase);
+  }
+  sink->Number(state.InformationTokens());
+  sink->Phrase(kClueTokensPhrase);
+  sink->Number(state.LifeTokens());
+  sink->Phrase(kLifeTokensPhrase);
+
+  sink->Phrase(kFireworksPhrase);
+  for (int c = 0; c < game->NumColors(); ++c) {
+    sink->Color(c);
+    sink->Separator();
+    sink->Number(state.Fireworks()[c]);
+    sink->Separator();
+  }
+
+  const std::vector<HanabiHand>& hands = state.Hands();
+  int num_hands = static_cast<int>(hands.size());
+  int cur_player = state.CurPlayer();
+  if (cur_player >= 0 && cur_player < num_hands) {
+    sink->Phrase(kOwnHandPhrase);
+    for (const auto& card : hands[cur_player].Knowledge()) {
+      knowledge(card);
+    }
+  }
+  int offset = 1;
+  for (int i = 0; i < num_hands; ++i) {
+    if (i == cur_player) {
+      continue;
+    }
+    sink->Phrase(kPlayerPhrase);
+    sink->Number(offset);
+    sink->Phrase(kHandPhrase);
+    for (const auto& card : hands[i].Cards()) {
+      sink->Color(card.Color());
+      sink->Separator();
+      sink->Rank(card.Rank());
+      sink->Separator();
+    }
+    sink->Phrase(kPlayerPhrase);
+    sink->Number(offset);
+    sink->Phrase(kRevealedPhrase);
+    for (const auto& card : hands[i].Knowledge()) {
+      knowledge(card);
+    }
+    ++offset;
+  }
+  sink->Phrase(kEndPhrase);
+}
+
+// Appends the text of RenderState() to text. Reusing text across calls
+// avoids any allocation once it has grown to the length of a state.
+void AppendStateText(const HanabiState& state, bool with_num_players,
+                     std::string* text);
+
+}  // namespace hanabi_learning_env
+
+#endif
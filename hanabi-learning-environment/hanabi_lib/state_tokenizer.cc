@@ -0,0 +1,138 @@
+#include "state_tokenizer.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <tokenizers_cpp.h>
+
+#include "util.h"
+
+namespace hanabi_learning_env {
+
+namespace {
+
+std::mutex tokenizer_path_mutex;
+bool tokenizer_loaded = false;
+
+std::string& TokenizerPath() {
+  static std::string path = [] {
+    const char* env = std::getenv("HANABI_TOKENIZER");
+    return std::string(
+        env != nullptr ? env
+                       : "../hanabi-learning-environment/hanabi_lib/dist/tokenizer.json");
+  }();
+  return path;
+}
+
+std::unique_ptr<tokenizers::Tokenizer> LoadTokenizer(const std::string& path) {
+  std::ifstream fs(path, std::ios::in | std::ios::binary);
+  if (fs.fail()) {
+    std::cerr << "Cannot open " << path << std::endl;
+    exit(1);
+  }
+  std::string data((std::istreambuf_iterator<char>(fs)),
+                   std::istreambuf_iterator<char>());
+  std::cout << "Loaded Tokenizer - " << path << std::endl;
+  return tokenizers::Tokenizer::FromBlobJSON(data);
+}
+
+}  // namespace
+
+void SetTokenizerPath(const std::string& path) {
+  std::lock_guard<std::mutex> lk(tokenizer_path_mutex);
+  if (tokenizer_loaded) {
+    std::cerr << "Tokenizer already loaded from " << TokenizerPath()
+              << ", ignoring " << path << std::endl;
+    return;
+  }
+  TokenizerPath() = path;
+}
+
+const StateTokenizer& SharedStateTokenizer() {
+  // initialized exactly once, concurrent callers wait for it
+  static const StateTokenizer tokenizer = [] {
+    std::string path;
+    {
+      std::lock_guard<std::mutex> lk(tokenizer_path_mutex);
+      tokenizer_loaded = true;
+      path = TokenizerPath();
+    }
+    auto tok = LoadTokenizer(path);
+    return StateTokenizer(
+        [&tok](const std::string& text) { return tok->Encode(text); });
+  }();
+  return tokenizer;
+}
+
+StateTokenizer::StateTokenizer(const Encoder& raw_encode) {
+  // special tokens the tokenizer may add around any text, e.g. [CLS] and
+  // [SEP], are emitted once around the whole state instead
+  Ids empty = raw_encode("");
+  Ids dot = raw_encode(".");
+  size_t num_prefix = 0;
+  while (num_prefix < empty.size() && empty[num_prefix] == dot[num_prefix]) {
+    ++num_prefix;
+  }
+  prefix_.assign(empty.begin(), empty.begin() + num_prefix);
+  suffix_.assign(empty.begin() + num_prefix, empty.end());
+  auto encode = [&](const std::string& text) {
+    Ids ids = raw_encode(text);
+    assert(ids.size() >= empty.size());
+    return Ids(ids.begin() + prefix_.size(), ids.end() - suffix_.size());
+  };
+
+  for (int n = 0; n < kMaxNumber; ++n) {
+    number_.push_back(encode(std::to_string(n)));
+  }
+  for (int c = 0; c < kMaxNumColors; ++c) {
+    color_.push_back(encode(StateColorText(c)));
+  }
+  for (int r = 0; r < kMaxNumRanks; ++r) {
+    rank_.push_back(encode(StateRankText(r)));
+  }
+  unknown_ = encode(StateColorText(-1));
+  for (int p = 0; p < kNumStatePhrases; ++p) {
+    phrase_.push_back(encode(kStatePhraseText[p]));
+  }
+}
+
+// RenderState() sink appending the ids of each fragment, separators have no
+// ids of their own
+class StateTokenizer::IdSink {
+ public:
+  IdSink(const StateTokenizer& table, std::vector<int>* ids)
+      : table_(table), ids_(ids) {}
+
+  void Phrase(StatePhrase phrase) { Append(table_.phrase_[phrase]); }
+  void Number(int n) {
+    assert(n >= 0 && n < kMaxNumber);
+    Append(table_.number_[n]);
+  }
+  void Color(int color) {
+    Append(color >= 0 ? table_.color_[color] : table_.unknown_);
+  }
+  void Rank(int rank) {
+    Append(rank >= 0 ? table_.rank_[rank] : table_.unknown_);
+  }
+  void Separator() {}
+
+  void Append(const Ids& fragment) {
+    ids_->insert(ids_->end(), fragment.begin(), fragment.end());
+  }
+
+ private:
+  const StateTokenizer& table_;
+  std::vector<int>* ids_;
+};
+
+void StateTokenizer::Tokenize(const HanabiState& state,
+                              std::vector<int>* ids) const {
+  IdSink sink(*this, ids);
+  sink.Append(prefix_);
+  RenderState(state, true, &sink);
+  sink.Append(suffix_);
+}
+
+}  // namespace hanabi_learning_env
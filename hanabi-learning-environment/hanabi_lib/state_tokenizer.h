@@ -0,0 +1,61 @@
+#ifndef __STATE_TOKENIZER_H__
+#define __STATE_TOKENIZER_H__
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "hanabi_state.h"
+#include "state_text.h"
+
+namespace hanabi_learning_env {
+
+// Token ids of HanabiState::ToTokenizeText() emitted straight from the state
+// fields, without building the text or running the tokenizer on it.
+//
+// The text is the sequence of fixed fragments (phrases, numbers, color and
+// rank names) walked by RenderState(), and every boundary between fragments
+// is a space or a punctuation mark. The BERT pre-tokenizer splits the text into words there
+// before WordPiece runs on each word, so the ids of the text are the ids of
+// its fragments concatenated. The ids of every fragment are looked up once,
+// with the real tokenizer, at construction.
+class StateTokenizer {
+ public:
+  using Encoder = std::function<std::vector<int>(const std::string&)>;
+
+  // Numbers in the text (players, tokens, fireworks) are below kMaxNumber.
+  static constexpr int kMaxNumber = 100;
+
+  explicit StateTokenizer(const Encoder& encode);
+
+  // Appends the ids of state to ids.
+  void Tokenize(const HanabiState& state, std::vector<int>* ids) const;
+
+ private:
+  using Ids = std::vector<int>;
+  class IdSink;
+
+  std::vector<Ids> number_;
+  // By color and rank index.
+  std::vector<Ids> color_;
+  std::vector<Ids> rank_;
+  Ids unknown_;
+  // By StatePhrase.
+  std::vector<Ids> phrase_;
+  // Special tokens around the text.
+  Ids prefix_;
+  Ids suffix_;
+};
+
+// Path of the tokenizer.json SharedStateTokenizer() is built from. Defaults
+// to $HANABI_TOKENIZER, or to hanabi_lib/dist/tokenizer.json relative to
+// pyhanabi/. Has no effect after the first SharedStateTokenizer() call.
+void SetTokenizerPath(const std::string& path);
+
+// Process wide table used by HanabiState::ToTokenize(), built on first use.
+// The tokenizer is read and parsed once for it and freed again.
+const StateTokenizer& SharedStateTokenizer();
+
+}  // namespace hanabi_learning_env
+
+#endif
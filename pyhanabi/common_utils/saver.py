@@ -36,21 +36,21 @@ class TopkSaver:
             weight_name = os.path.join(self.save_dir, "%s.pthw" % force_save_name)
             optim_name = os.path.join(self.save_dir, "%s.pth" % force_save_name_optim)
             replay_name = os.path.join(
-                self.save_dir, "%s.pth" % force_replay_buffer_path
+                self.save_dir, "%s.snapshot" % force_replay_buffer_path
             )
             torch.save(state_dict, weight_name)
             torch.save(optim_dict, optim_name)
-            torch.save(replay_buffer, replay_name)
+            replay_buffer.save_snapshot(replay_name)
             if config is not None:
                 pickle.dump(config, open(f"{weight_name}.cfg", "wb"))
 
         if save_latest:
             weight_name = os.path.join(self.save_dir, "latest.pthw")
             optim_name = os.path.join(self.save_dir, "latest_optim.pth")
-            replay_name = os.path.join(self.save_dir, "replay.pth")
+            replay_name = os.path.join(self.save_dir, "replay.snapshot")
             torch.save(state_dict, weight_name)
             torch.save(optim_dict, optim_name)
-            torch.save(replay_buffer, replay_name)
+            replay_buffer.save_snapshot(replay_name)
 
             if config is not None:
                 pickle.dump(config, open(f"{weight_name}.cfg", "wb"))
@@ -67,10 +67,10 @@ class TopkSaver:
         )
 
         perf_label = int(self.worse_perf) if math.isfinite(self.worse_perf) else "neginf"
-        replay_name = os.path.join(self.save_dir, f"replay{perf_label}.pthw")
+        replay_name = os.path.join(self.save_dir, f"replay{perf_label}.snapshot")
         torch.save(state_dict, weight_name)
         torch.save(optim_dict, optim_name)
-        torch.save(replay_buffer, replay_name)
+        replay_buffer.save_snapshot(replay_name)
 
         if config is not None:
             pickle.dump(config, open(f"{weight_name}.cfg", "wb"))
@@ -16,6 +16,7 @@ def create_envs(
     num_color=5,
     num_rank=5,
     num_hint=8,
+    max_state_tokens=196,
 ):
     games = []
     for game_idx in range(num_env):
@@ -34,6 +35,7 @@ def create_envs(
             max_len,
             False,
         )
+        game.set_max_state_tokens(max_state_tokens)
         games.append(game)
     return games
 
@@ -46,9 +48,28 @@ def flatten(s):
     return s[:1] + flatten(s[1:])
 
 
-def create_threads(num_thread, num_game_per_thread, actors, games):
+def flatten_once(s):
+    return [x for sub in s for x in sub]
+
+
+def create_threads(num_thread, num_game_per_thread, actors, games, work_stealing=False):
     context = rela.Context()
     threads = []
+    if work_stealing:
+        # one pool of envs shared by all threads instead of a fixed slice each
+        envs = games[: num_thread * num_game_per_thread]
+        tasks = hanalearn.HanabiEnvTasks(envs, flatten_once(actors[:num_thread]), False)
+        executor = rela.WorkStealingExecutor(tasks, num_thread)
+        for thread_idx in range(num_thread):
+            thread = rela.WorkStealingLoop(executor, thread_idx)
+            threads.append(thread)
+            context.push_thread_loop(thread)
+        print(
+            "Finished creating %d work stealing threads with %d games and %d actors"
+            % (len(threads), len(envs), len(flatten(actors)))
+        )
+        return context, threads
+
     for thread_idx in range(num_thread):
         envs = games[
             thread_idx * num_game_per_thread : (thread_idx + 1) * num_game_per_thread
@@ -22,6 +22,7 @@ def evaluate(
     num_color=5,
     num_rank=5,
     num_hint=8,
+    max_state_tokens=196,
     llm_priors=None,
     pikl_lambdas=None,
     pikl_betas=None,
@@ -48,6 +49,7 @@ def evaluate(
         num_color=num_color,
         num_rank=num_rank,
         num_hint=num_hint,
+        max_state_tokens=max_state_tokens,
     )
     threads = []
 
@@ -73,7 +73,45 @@ def parse_args():
     parser.add_argument("--replay_buffer_size", type=int, default=10000)
     parser.add_argument("--max_len", type=int, default=80, help="max seq len")
     parser.add_argument("--prefetch", type=int, default=3, help="#prefetch batch")
+    parser.add_argument(
+        "--num_gather_thread", type=int, default=0, help="#threads assembling a batch"
+    )
+    parser.add_argument(
+        "--seq_first_storage", type=int, default=0, help="store replay as [T, N, ...]"
+    )
+    parser.add_argument(
+        "--compact_storage", type=int, default=0, help="bit pack / int16 replay obs"
+    )
+    parser.add_argument(
+        "--replay_buffer_steps",
+        type=int,
+        default=0,
+        help="if > 0, store episodes unpadded and keep this many steps",
+    )
+    parser.add_argument(
+        "--replay_num_shard", type=int, default=1, help="#replay shards, by actor thread"
+    )
+    parser.add_argument(
+        "--replay_staging", type=int, default=1, help="#episodes per actor thread append"
+    )
+    parser.add_argument(
+        "--cold_replay_dir", type=str, default="", help="spill evicted episodes here"
+    )
+    parser.add_argument("--cold_replay_size", type=int, default=1000000)
+    parser.add_argument("--cold_replay_chunk", type=int, default=256)
+    parser.add_argument(
+        "--cold_replay_ratio", type=float, default=0.5, help="fraction of batch from disk"
+    )
+    parser.add_argument(
+        "--load_replay", type=str, default="", help="replay snapshot dir to resume from"
+    )
     parser.add_argument("--burn_in_frames", type=int, default=1000)
+    parser.add_argument(
+        "--tokenizer_path", type=str, default="", help="tokenizer.json of priv_s_text"
+    )
+    parser.add_argument(
+        "--max_state_tokens", type=int, default=196, help="priv_s_text is padded/cut to it"
+    )
 
     # llm setting
     parser.add_argument("--llm_prior", type=str, default=None)
@@ -136,6 +174,8 @@ def train(args):
     sys.stdout = common_utils.Logger(logger_path, print_to_stdout=True)
     pprint.pprint(vars(args))
     utils.print_gpu_info()
+    if args.tokenizer_path:
+        hanalearn.set_tokenizer_path(args.tokenizer_path)
 
     if not os.path.exists(args.save_dir):
         os.makedirs(args.save_dir)
@@ -153,6 +193,7 @@ def train(args):
         num_color=args.num_color,
         num_rank=args.num_rank,
         num_hint=args.num_hint,
+        max_state_tokens=args.max_state_tokens,
     )
 
     agent = r2d2.R2D2Agent(
@@ -188,7 +229,28 @@ def train(args):
         args.replay_buffer_size,
         args.seed,
         args.prefetch,
+        args.num_gather_thread,
+        bool(args.seq_first_storage),
+        args.replay_buffer_steps,
+        args.replay_num_shard,
     )
+    if args.compact_storage:
+        replay_buffer.set_obs_codec("priv_s", "bits", games[0].binary_feature_size())
+        replay_buffer.set_obs_codec("legal_move", "bits", -1)
+        # ids of the BERT WordPiece vocabulary of the text encoder
+        replay_buffer.set_obs_codec("priv_s_text", "int16", 30522)
+    replay_buffer.set_staging_size(args.replay_staging)
+    if args.cold_replay_dir:
+        replay_buffer.set_cold_tier(
+            args.cold_replay_dir,
+            args.cold_replay_size,
+            args.cold_replay_chunk,
+            16 * args.cold_replay_chunk,
+            args.cold_replay_ratio,
+        )
+    if args.load_replay:
+        replay_buffer.load_snapshot(args.load_replay)
+        print("loaded %d episodes from %s" % (replay_buffer.size(), args.load_replay))
 
     explore_eps = utils.generate_explore_eps(
         args.act_base_eps, args.act_eps_alpha, args.num_eps
@@ -275,6 +337,7 @@ def train(args):
             num_color=args.num_color,
             num_rank=args.num_rank,
             num_hint=args.num_hint,
+            max_state_tokens=args.max_state_tokens,
         )
         perfect *= 100
     else:
@@ -286,6 +349,10 @@ def train(args):
         print("warming up replay buffer:", replay_buffer.size())
         time.sleep(1)
     print("Success, Done")
+    print(
+        "replay bytes/episode: %d (%d before encoding)"
+        % (replay_buffer.bytes_per_episode(), replay_buffer.raw_bytes_per_episode())
+    )
     print("=" * 100)
 
     frame_stat = dict()
@@ -385,6 +452,7 @@ def train(args):
                     num_color=args.num_color,
                     num_rank=args.num_rank,
                     num_hint=args.num_hint,
+                    max_state_tokens=args.max_state_tokens,
                 )
                 perfect *= 100
                 print(common_utils.get_mem_usage("(after eval)"))
@@ -15,16 +15,165 @@ FutureReply BatchRunner::call(const std::string& method, const TensorDict& t) co
   return batcherIt->second->send(t);
 }
 
+std::unordered_map<std::string, double> BatchRunner::getBatcherStats(
+    const std::string& method) const {
+  auto batcherIt = batchers_.find(method);
+  if (batcherIt == batchers_.end()) {
+    std::cerr << "Error: Cannot find method: " << method << std::endl;
+    assert(false);
+  }
+  return batcherIt->second->getStats();
+}
+
+std::unordered_map<std::string, std::unordered_map<std::string, double>>
+BatchRunner::getHistograms(const std::string& method) const {
+  auto batcherIt = batchers_.find(method);
+  if (batcherIt == batchers_.end()) {
+    std::cerr << "Error: Cannot find method: " << method << std::endl;
+    assert(false);
+  }
+  return batcherIt->second->getHistograms();
+}
+
+void BatchRunner::resetHistograms(const std::string& method) {
+  auto batcherIt = batchers_.find(method);
+  if (batcherIt == batchers_.end()) {
+    std::cerr << "Error: Cannot find method: " << method << std::endl;
+    assert(false);
+  }
+  batcherIt->second->resetHistograms();
+}
+
+void BatchRunner::logAndClearAggSize() {
+  // the histograms are left alone, get_histograms() keeps seeing them
+  int64_t aggSize = aggSize_.exchange(0);
+  int64_t aggCount = aggCount_.exchange(0);
+  std::cout << "total #sample evaluated: " << aggSize
+            << ", #batch: " << aggCount
+            << ", avg bsz: " << (aggCount ? (double)aggSize / aggCount : 0) << std::endl;
+}
+
 void BatchRunner::start() {
   for (size_t i = 0; i < methods_.size(); ++i) {
-    batchers_.emplace(methods_[i], std::make_unique<Batcher>(batchsizes_[i]));
+    batchers_.emplace(
+        methods_[i],
+        std::make_unique<Batcher>(
+            batchsizes_[i], lockFreeBatcher_, device_, numBuffer_, policies_[i]));
+  }
+
+  {
+    std::lock_guard<std::mutex> lk(mtxUpdate_);
+    for (int s = 0; s < 2; ++s) {
+      auto& slot = slots_[s];
+      slot = std::make_shared<ModelSlot>();
+      for (int i = 0; i < numWorker_; ++i) {
+        // Module is a handle, a copy forwards on the weights of jitModel_
+        slot->replicas.push_back(std::make_unique<torch::jit::script::Module>(
+            s == 0 && i == 0 ? *jitModel_ : jitModel_->clone()));
+      }
+      slot->version = modelVersion_.load();
+    }
+    // slots_[0] starts as the shadow, acquireModelLock() needs no flip
+    std::atomic_store(&activeSlot_, slots_[1]);
   }
 
   for (auto& kv : batchers_) {
-    threads_.emplace_back(&BatchRunner::runnerLoop, this, kv.first);
+    for (int i = 0; i < numWorker_; ++i) {
+      threads_.emplace_back(&BatchRunner::runnerLoop, this, kv.first, i);
+    }
   }
 }
 
+BatchRunner::WeightMap BatchRunner::namedWeights(const torch::jit::script::Module& model) {
+  WeightMap weights;
+  for (const auto& p : model.named_parameters(true)) {
+    weights[p.name] = p.value;
+  }
+  for (const auto& b : model.named_buffers(true)) {
+    weights[b.name] = b.value;
+  }
+  return weights;
+}
+
+void BatchRunner::loadWeights(const WeightMap& src, ModelSlot& slot, size_t begin) {
+  torch::NoGradGuard ng;
+  for (size_t i = begin; i < slot.replicas.size(); ++i) {
+    for (const auto& kv : namedWeights(*slot.replicas[i])) {
+      auto it = src.find(kv.first);
+      if (it == src.end()) {
+        throw std::runtime_error("BatchRunner: missing weight " + kv.first);
+      }
+      kv.second.copy_(it->second);
+    }
+  }
+}
+
+void BatchRunner::waitIdle(const std::shared_ptr<ModelSlot>& slot) {
+  // runner threads may still finish a forward on the slot that they
+  // picked up before the previous flip
+  while (slot.use_count() > 1) {
+    std::this_thread::yield();
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
+}
+
+std::shared_ptr<BatchRunner::ModelSlot>& BatchRunner::waitShadow() {
+  bool firstActive = std::atomic_load(&activeSlot_) == slots_[0];
+  auto& shadow = firstActive ? slots_[1] : slots_[0];
+  waitIdle(shadow);
+  return shadow;
+}
+
+void BatchRunner::acquireModelLock() {
+  mtxUpdate_.lock();
+  if (std::atomic_load(&activeSlot_) == nullptr) {
+    // not started yet, replicas will be cloned from jitModel_
+    return;
+  }
+  if (std::atomic_load(&activeSlot_) == slots_[0]) {
+    // python is about to write into jitModel_, which slots_[0] forwards
+    // on, so serve the current weights from slots_[1] meanwhile
+    auto& shadow = waitShadow();
+    loadWeights(namedWeights(*jitModel_), *shadow, 0);
+    shadow->version = slots_[0]->version;
+    std::atomic_store(&activeSlot_, shadow);
+  }
+  waitIdle(slots_[0]);
+}
+
+void BatchRunner::releaseModelLock() {
+  int64_t version = ++modelVersion_;
+  if (std::atomic_load(&activeSlot_) != nullptr) {
+    // replica 0 already holds the new weights
+    loadWeights(namedWeights(*jitModel_), *slots_[0], 1);
+    slots_[0]->version = version;
+    std::atomic_store(&activeSlot_, slots_[0]);
+  }
+  mtxUpdate_.unlock();
+}
+
+void BatchRunner::updateModel(py::object agent) {
+  std::lock_guard<std::mutex> lk(mtxUpdate_);
+  py::object stateDict = agent.attr("state_dict")();
+  int64_t version = ++modelVersion_;
+  if (std::atomic_load(&activeSlot_) == nullptr) {
+    pyModel_.attr("load_state_dict")(stateDict);
+    return;
+  }
+
+  WeightMap src;
+  for (const auto& kv : py::dict(stateDict)) {
+    src[kv.first.cast<std::string>()] = kv.second.cast<torch::Tensor>();
+  }
+
+  // one copy per replica, jitModel_ is only written when its slot is
+  // the shadow
+  auto& shadow = waitShadow();
+  loadWeights(src, *shadow, 0);
+  shadow->version = version;
+  std::atomic_store(&activeSlot_, shadow);
+}
+
 void BatchRunner::stop() {
   // batchers_.clear();
   for (auto& kv : batchers_) {
@@ -38,46 +187,28 @@ void BatchRunner::stop() {
   }
   batchers_.clear();
   threads_.clear();
+  std::atomic_store(&activeSlot_, std::shared_ptr<ModelSlot>());
+  slots_[0].reset();
+  slots_[1].reset();
 }
 
 // for debugging
 rela::TensorDict BatchRunner::blockCall(const std::string& method, const TensorDict& t) {
-  std::cout << "    BatchRunner::blockCall() - Method: " << method << std::endl;
-  std::cout << "    Input TensorDict size: " << t.size() << std::endl;
-  for (const auto& kv : t) {
-    std::cout << "      Key: " << kv.first << ", Shape: ";
-    if (kv.second.dim() == 0) {
-      std::cout << "scalar";
-    } else {
-      std::cout << "[";
-      for (int i = 0; i < kv.second.dim(); ++i) {
-        if (i > 0) std::cout << ", ";
-        std::cout << kv.second.size(i);
-      }
-      std::cout << "]";
-    }
-    std::cout << std::endl;
-  }
-  
+  RELA_TRACE("BatchRunner::blockCall() method: " << method << "\n"
+             << tensor_dict::shapeString(t, "  "));
+
   torch::NoGradGuard ng;
   std::vector<torch::jit::IValue> input;
-  std::cout << "    Converting input to IValue..." << std::endl;
   input.push_back(tensor_dict::toIValue(t, device_));
-  std::cout << "    IValue vector size: " << input.size() << std::endl;
-  std::cout << "    Calling JIT model method: " << method << std::endl;
-  
   torch::jit::IValue output;
   {
     std::lock_guard<std::mutex> lk(mtxUpdate_);
     output = jitModel_->get_method(method)(input);
   }
-  std::cout << "    Converting output from IValue..." << std::endl;
-  auto result = tensor_dict::fromIValue(output, torch::kCPU, true);
-  std::cout << "    blockCall completed successfully" << std::endl;
-  return result;
+  return tensor_dict::fromIValue(output, torch::kCPU, true);
 }
 
-void BatchRunner::runnerLoop(const std::string& method) {
+void BatchRunner::runnerLoop(const std::string& method, int workerIdx) {
   auto batcherIt = batchers_.find(method);
   if (batcherIt == batchers_.end()) {
     std::cerr << "Error: RunnerLoop, Cannot find method: " << method << std::endl;
@@ -85,21 +216,27 @@ void BatchRunner::runnerLoop(const std::string& method) {
   }
   auto& batcher = *(batcherIt->second);
 
+  if (numIntraOpThread_ > 0) {
+    // with the default OpenMP backend this only affects the calling thread
+    torch::set_num_threads(numIntraOpThread_);
+  }
+
   int aggSize = 0;
   int aggCount = 0;
 
   while (!batcher.terminated()) {
-    auto batch = batcher.get();
+    int64_t gen = -1;
+    auto batch = batcher.get(&gen);
     if (batch.empty()) {
       assert(batcher.terminated());
       break;
     }
 
+    aggSize_ += batch.begin()->second.size(0);
+    ++aggCount_;
     if (logFreq_ > 0) {
       aggSize += batch.begin()->second.size(0);
       aggCount += 1;
-      aggSize_ += batch.begin()->second.size(0);
-      aggCount_ += 1;
 
       if (aggCount % logFreq_ == 0) {
         std::cout << method << ", average batchsize: " << aggSize / (float)aggCount
@@ -113,14 +250,27 @@ void BatchRunner::runnerLoop(const std::string& method) {
       // std::lock_guard<std::mutex> lk(mtxDevice_);
 
       torch::NoGradGuard ng;
+      auto begin = std::chrono::steady_clock::now();
       std::vector<torch::jit::IValue> input;
+      // batcher has already staged the batch on device_, to() is a no-op
       input.push_back(tensor_dict::toIValue(batch, device_));
       torch::jit::IValue output;
+      int64_t version = 0;
       {
-        std::lock_guard<std::mutex> lk(mtxUpdate_);
-        output = jitModel_->get_method(method)(input);
+        // hold the slot so that no update overwrites it
+        auto slot = std::atomic_load(&activeSlot_);
+        output = slot->replicas[workerIdx]->get_method(method)(input);
+        version = slot->version;
+      }
+      auto reply = tensor_dict::fromIValue(output, torch::kCPU, true);
+      if (!versionKey_.empty()) {
+        int64_t bsize = batch.begin()->second.size(0);
+        reply[versionKey_] = torch::full({bsize}, version, torch::kInt64);
       }
-      batcher.set(tensor_dict::fromIValue(output, torch::kCPU, true));
+      auto end = std::chrono::steady_clock::now();
+      batcher.recordForward(
+          std::chrono::duration<double, std::micro>(end - begin).count());
+      batcher.set(std::move(reply), gen);
     }
   }
 }
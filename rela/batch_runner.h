@@ -1,9 +1,13 @@
 #pragma once
 
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <memory>
 #include <thread>
 
 #include "rela/batcher.h"
+#include "rela/logging.h"
 #include "rela/tensor_dict.h"
 
 namespace rela {
@@ -14,18 +18,22 @@ class BatchRunner {
       py::object pyModel,
       const std::string& device,
       int maxBatchsize,
-      const std::vector<std::string>& methods)
+      const std::vector<std::string>& methods,
+      bool lockFreeBatcher = false)
       : pyModel_(pyModel)
       , jitModel_(pyModel_.attr("_c").cast<torch::jit::script::Module*>())
       , device_(torch::Device(device))
+      , lockFreeBatcher_(lockFreeBatcher)
       , batchsizes_(methods.size(), maxBatchsize)
+      , policies_(methods.size())
       , methods_(methods) {
   }
 
-  BatchRunner(py::object pyModel, const std::string& device)
+  BatchRunner(py::object pyModel, const std::string& device, bool lockFreeBatcher = false)
       : pyModel_(pyModel)
       , jitModel_(pyModel_.attr("_c").cast<torch::jit::script::Module*>())
-      , device_(torch::Device(device)) {
+      , device_(torch::Device(device))
+      , lockFreeBatcher_(lockFreeBatcher) {
   }
 
   BatchRunner(const BatchRunner&) = delete;
@@ -39,28 +47,66 @@ class BatchRunner {
     logFreq_ = logFreq;
   }
 
-  void addMethod(const std::string& method, int batchSize) {
+  // #runner threads per method, each with its own replica of the model.
+  // numIntraOpThread > 0 sets the intra-op threads of every runner thread.
+  // set before start()
+  void setNumWorker(int numWorker, int numIntraOpThread) {
+    assert(threads_.empty());
+    assert(numWorker >= 1);
+    numWorker_ = numWorker;
+    numIntraOpThread_ = numIntraOpThread;
+  }
+
+  // depth of the batch buffer ring of each method, set before start()
+  void setNumBuffer(int numBuffer) {
+    assert(threads_.empty());
+    assert(numBuffer >= 2);
+    numBuffer_ = numBuffer;
+  }
+
+  void addMethod(
+      const std::string& method,
+      int batchSize,
+      const BatchPolicy& policy = BatchPolicy()) {
     batchsizes_.push_back(batchSize);
+    policies_.push_back(policy);
     methods_.push_back(method);
   }
 
   FutureReply call(const std::string& method, const TensorDict& t) const;
 
+  std::unordered_map<std::string, double> getBatcherStats(const std::string& method) const;
+
+  // latency and batch size histograms of method, see Batcher::getHistograms
+  std::unordered_map<std::string, std::unordered_map<std::string, double>>
+  getHistograms(const std::string& method) const;
+
+  void resetHistograms(const std::string& method);
+
   void start();
 
   void stop();
 
-  void acquireModelLock() {
-    mtxUpdate_.lock();
-  }
+  // pyModel_ is replica 0 of slots_[0], runner threads are moved off that
+  // slot before python writes into it
+  void acquireModelLock();
+
+  // pyModel_ may have been modified while the lock was held
+  void releaseModelLock();
 
-  void releaseModelLock() {
-    mtxUpdate_.unlock();
+  // loads the weights of agent straight into the shadow replicas
+  void updateModel(py::object agent);
+
+  // #weight updates published so far
+  int64_t modelVersion() const {
+    return modelVersion_.load();
   }
 
-  void updateModel(py::object agent) {
-    std::lock_guard<std::mutex> lk(mtxUpdate_);
-    pyModel_.attr("load_state_dict")(agent.attr("state_dict")());
+  // if set, every reply carries key -> [bsize] int64 tensor holding the
+  // version of the weights that produced it, set before start()
+  void setVersionKey(const std::string& key) {
+    assert(threads_.empty());
+    versionKey_ = key;
   }
 
   const torch::jit::script::Module& jitModel() {
@@ -70,33 +116,63 @@ class BatchRunner {
   // for debugging
   rela::TensorDict blockCall(const std::string& method, const TensorDict& t);
 
-  void logAndClearAggSize() {
-    assert(logFreq_);
-    std::cout << "total #sample evaluated: " << aggSize_
-              << ", #batch: " << aggCount_
-              << ", avg bsz: " << aggSize_ / aggCount_ << std::endl;
-    aggSize_ = 0;
-    aggCount_ = 0;
-  }
+  void logAndClearAggSize();
 
  private:
-  void runnerLoop(const std::string& method);
+  void runnerLoop(const std::string& method, int workerIdx);
+
+  // one replica of the model per runner thread, all at the same version
+  struct ModelSlot {
+    std::vector<std::unique_ptr<torch::jit::script::Module>> replicas;
+    int64_t version = 0;
+  };
+
+  using WeightMap = std::unordered_map<std::string, torch::Tensor>;
+
+  static WeightMap namedWeights(const torch::jit::script::Module& model);
+
+  // copy src into replicas [begin, end) of slot
+  static void loadWeights(const WeightMap& src, ModelSlot& slot, size_t begin);
+
+  // blocks until no forward holds slot, mtxUpdate_ must be held and slot
+  // must not be activeSlot_
+  static void waitIdle(const std::shared_ptr<ModelSlot>& slot);
+
+  // the slot that is not active, once no forward holds it anymore
+  std::shared_ptr<ModelSlot>& waitShadow();
 
   py::object pyModel_;
   torch::jit::script::Module* const jitModel_;
   const torch::Device device_;
+  // use the atomic slot reservation of Batcher instead of mNextSlot_
+  const bool lockFreeBatcher_;
   std::vector<int> batchsizes_;
+  std::vector<BatchPolicy> policies_;
   std::vector<std::string> methods_;
 
   // ideally this mutex should be 1 per device, thus global
   // std::mutex mtxDevice_;
   std::mutex mtxUpdate_;
 
+  // double buffered weights, activeSlot_ is read with std::atomic_load
+  // and points to one of slots_, the other one is the shadow that the
+  // next update writes into once no forward holds it anymore. Replica 0
+  // of slots_[0] shares its weights with jitModel_, so one worker keeps
+  // two copies of the model
+  std::shared_ptr<ModelSlot> slots_[2];
+  std::shared_ptr<ModelSlot> activeSlot_;
+  std::atomic<int64_t> modelVersion_{0};
+  std::string versionKey_;
+
   mutable std::map<std::string, std::unique_ptr<Batcher>> batchers_;
   std::vector<std::thread> threads_;
 
+  int numWorker_ = 1;
+  int numIntraOpThread_ = 0;
+  int numBuffer_ = 2;
   int logFreq_ = -1;
-  int aggSize_ = 0;
-  int aggCount_ = 0;
+  // over all methods since the last logAndClearAggSize()
+  std::atomic<int64_t> aggSize_{0};
+  std::atomic<int64_t> aggCount_{0};
 };
 }  // namespace rela
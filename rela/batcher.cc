@@ -22,6 +22,39 @@ TensorDict allocateBatchStorage(const TensorDict& data, int bsz) {
   return storage;
 }
 
+// every key starts at a multiple of kArenaAlign bytes inside the arena
+static constexpr int64_t kArenaAlign = 64;
+
+static int64_t alignArena(int64_t bytes) {
+  return (bytes + kArenaAlign - 1) / kArenaAlign * kArenaAlign;
+}
+
+int64_t batchArenaBytes(const TensorDict& data, int bsz) {
+  int64_t total = 0;
+  for (const auto& kv : data) {
+    total += alignArena(bsz * kv.second.numel() * kv.second.element_size());
+  }
+  return total;
+}
+
+TensorDict viewBatchArena(const TensorDict& data, int bsz, const torch::Tensor& arena) {
+  assert(arena.is_contiguous() && arena.scalar_type() == torch::kUInt8);
+  assert(arena.numel() >= batchArenaBytes(data, bsz));
+
+  TensorDict storage;
+  int64_t offset = 0;
+  auto base = arena.data_ptr<uint8_t>();
+  for (const auto& kv : data) {
+    auto sizes = getBatchedSize(kv.second, bsz);
+    auto options = torch::TensorOptions().dtype(kv.second.dtype()).device(arena.device());
+    // the deleter holds a reference to keep the arena alive with its views
+    storage[kv.first] = torch::from_blob(
+        base + offset, sizes, [arena](void*) {}, options);
+    offset += alignArena(bsz * kv.second.numel() * kv.second.element_size());
+  }
+  return storage;
+}
+
 class FutureReply_ {
  public:
   FutureReply_()
@@ -46,17 +79,48 @@ class FutureReply_ {
   }
 
   void set(TensorDict&& t) {
+    std::vector<std::pair<std::shared_ptr<ReadyQueue>, int>> waiters;
     {
       std::lock_guard<std::mutex> lk(mReady_);
       ready_ = true;
       data_ = std::move(t);
+      waiters.swap(waiters_);
     }
     cvReady_.notify_all();
+
+    // one push per queue, a batch usually serves many slots of one loop
+    while (!waiters.empty()) {
+      auto queue = waiters.back().first;
+      std::vector<int> tags;
+      for (size_t i = 0; i < waiters.size();) {
+        if (waiters[i].first == queue) {
+          tags.push_back(waiters[i].second);
+          waiters[i] = std::move(waiters.back());
+          waiters.pop_back();
+        } else {
+          ++i;
+        }
+      }
+      queue->push(tags);
+    }
+  }
+
+  void notifyOnReady(std::shared_ptr<ReadyQueue> queue, int tag) {
+    {
+      std::lock_guard<std::mutex> lk(mReady_);
+      if (!ready_) {
+        waiters_.emplace_back(std::move(queue), tag);
+        return;
+      }
+    }
+    queue->push(tag);
   }
 
  private:
   // no need for protection, only set() can set it
   TensorDict data_;
+  // protected by mReady_
+  std::vector<std::pair<std::shared_ptr<ReadyQueue>, int>> waiters_;
 
   std::mutex mReady_;
   std::atomic<bool> ready_;
@@ -68,6 +132,11 @@ bool FutureReply::isReady() const {
   return fut_->isReady();
 }
 
+void FutureReply::notifyOnReady(std::shared_ptr<ReadyQueue> queue, int tag) const {
+  assert(fut_ != nullptr);
+  fut_->notifyOnReady(std::move(queue), tag);
+}
+
 TensorDict FutureReply::get() {
   assert(fut_ != nullptr);
   auto ret = fut_->get(slot);
@@ -75,101 +144,446 @@ TensorDict FutureReply::get() {
   return ret;
 }
 
-Batcher::Batcher(int batchsize)
+Batcher::Batcher(
+    int batchsize,
+    bool lockFree,
+    const torch::Device& device,
+    int numBuffer,
+    const BatchPolicy& policy)
     : batchsize_(batchsize)
+    , lockFree_(lockFree)
+    , device_(device)
+    , numBuffer_(numBuffer)
+    , policy_(policy)
+    , fillGen_(0)
     , nextSlot_(0)
-    , numActiveWrite_(0)
-    , fillingReply_(std::make_shared<FutureReply_>())
-    , filledReply_(nullptr) {
+    , state_(0)
+    , written_(new std::atomic<int>[numBuffer])
+    , closedSize_(new std::atomic<int>[numBuffer])
+    , firstSendNs_(new std::atomic<int64_t>[numBuffer])
+    , closeNs_(new std::atomic<int64_t>[numBuffer])
+    , replies_(numBuffer)
+    , released_(numBuffer, false)
+    , readGen_(0)
+    , freeGen_(0)
+    , batchsizeHist_(Histogram::linear(batchsize)) {
   assert(batchsize_ > 0);
+  assert(numBuffer_ >= 2);
+  assert(policy_.minBatchsize >= 1 && policy_.minBatchsize <= batchsize_);
+  for (int i = 0; i < numBuffer_; ++i) {
+    written_[i] = 0;
+    closedSize_[i] = 0;
+    firstSendNs_[i] = 0;
+    closeNs_[i] = 0;
+    replies_[i] = std::make_shared<FutureReply_>();
+  }
+}
+
+void Batcher::initBuffer(const TensorDict& t) {
+  std::call_once(initBuffer_, [&] {
+    int64_t bytes = batchArenaBytes(t, batchsize_);
+    // pinned host memory so that the device copy can be asynchronous
+    auto options = torch::TensorOptions().dtype(torch::kUInt8);
+    if (!device_.is_cpu()) {
+      options = options.pinned_memory(true);
+    }
+    for (int i = 0; i < numBuffer_; ++i) {
+      arenas_.push_back(torch::zeros({bytes}, options));
+      buffers_.push_back(viewBatchArena(t, batchsize_, arenas_.back()));
+      if (!device_.is_cpu()) {
+        auto deviceOptions = options.pinned_memory(false).device(device_);
+        deviceArenas_.push_back(torch::zeros({bytes}, deviceOptions));
+        deviceBuffers_.push_back(viewBatchArena(t, batchsize_, deviceArenas_.back()));
+      }
+    }
+  });
+
+  if (t.size() != buffers_[0].size()) {
+    std::cout << "key in buffer: " << std::endl;
+    utils::printMapKey(buffers_[0]);
+    std::cout << "key in data: " << std::endl;
+    utils::printMapKey(t);
+    assert(false);
+  }
+}
+
+void Batcher::write(const TensorDict& t, uint64_t gen, int slot) {
+  // at() instead of [] since multiple producers read the map concurrently
+  auto& buffer = buffers_[bufferIdx(gen)];
+  // this will copy
+  for (const auto& kv : t) {
+    auto dst = buffer.at(kv.first)[slot];
+    if (dst.sizes() != kv.second.sizes()) {
+      std::cout << "cannot batch data, batcher need size: " << dst.sizes()
+                << ", get: " << kv.second.sizes() << std::endl;
+    }
+    dst.copy_(kv.second);
+  }
+}
+
+bool Batcher::aliasesArena(const torch::Tensor& t) const {
+  if (!t.defined() || t.numel() == 0) {
+    return false;
+  }
+  auto ptr = static_cast<const uint8_t*>(t.data_ptr());
+  for (const auto& arena : arenas_) {
+    auto begin = arena.data_ptr<uint8_t>();
+    if (ptr >= begin && ptr < begin + arena.numel()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void Batcher::onClose(uint64_t gen, int size) {
+  assert(size > 0 && size <= batchsize_);
+  int idx = bufferIdx(gen);
+  int64_t now = Clock::now().time_since_epoch().count();
+  closeNs_[idx] = now;
+  closedSize_[idx] = size;
+  ++numClose_;
+  aggSize_ += size;
+  aggInFlight_ += (int64_t)(gen + 1 - freeGen_.load());
+
+  // the producer of slot 0 may not have stamped firstSendNs_ yet
+  int64_t firstNs = firstSendNs_[idx].load();
+  if (firstNs > 0) {
+    fillUs_.add((now - firstNs) * 1e-3);
+  }
+  batchsizeHist_.add(size);
 }
 
 // send data into batcher
 FutureReply Batcher::send(const TensorDict& t) {
+  initBuffer(t);
+  if (lockFree_) {
+    return sendLockFree(t);
+  }
+  return sendLocked(t);
+}
+
+FutureReply Batcher::sendLocked(const TensorDict& t) {
   std::unique_lock<std::mutex> lk(mNextSlot_);
 
-  // init buffer
-  if (fillingBuffer_.empty()) {
-    assert(filledBuffer_.empty());
-    fillingBuffer_ = allocateBatchStorage(t, batchsize_);
-    filledBuffer_ = allocateBatchStorage(t, batchsize_);
-  } else {
-    if (t.size() != fillingBuffer_.size()) {
-      std::cout << "key in buffer: " << std::endl;
-      utils::printMapKey(fillingBuffer_);
-      std::cout << "key in data: " << std::endl;
-      utils::printMapKey(t);
-      assert(false);
-    }
+  // wait if every buffer of the ring is full and not released
+  if (fillGen_ >= freeGen_ + numBuffer_) {
+    auto begin = std::chrono::steady_clock::now();
+    cvNextSlot_.wait(lk, [this] { return fillGen_ < freeGen_ + numBuffer_; });
+    auto end = std::chrono::steady_clock::now();
+    ++numStall_;
+    stallNs_ += std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
   }
 
-  assert(nextSlot_ <= batchsize_);
-  // wait if current batch is full and not extracted
-  cvNextSlot_.wait(lk, [this] { return nextSlot_ < batchsize_; });
-
+  assert(nextSlot_ < batchsize_);
+  uint64_t gen = fillGen_;
   int slot = nextSlot_;
+  if (slot == 0) {
+    firstSendNs_[bufferIdx(gen)] = Clock::now().time_since_epoch().count();
+  }
   ++nextSlot_;
-  ++numActiveWrite_;
+  if (nextSlot_ == batchsize_) {
+    // batch is full, later producers move on to the next buffer
+    onClose(gen, batchsize_);
+    ++fillGen_;
+    nextSlot_ = 0;
+  }
+  auto reply = replies_[bufferIdx(gen)];
+  assert(reply != nullptr);
   lk.unlock();
 
-  // this will copy
-  for (const auto& kv : t) {
-    if (fillingBuffer_[kv.first][slot].sizes() != kv.second.sizes()) {
-      std::cout << "cannot batch data, batcher need size: "
-                << fillingBuffer_[kv.first][slot].sizes()
-                << ", get: " << kv.second.sizes() << std::endl;
-    }
-    fillingBuffer_[kv.first][slot] = kv.second;
-  }
+  write(t, gen, slot);
 
-  // batch has not been extracted yet
-  assert(numActiveWrite_ > 0);
-  assert(fillingReply_ != nullptr);
-  auto reply = fillingReply_;
   lk.lock();
-  --numActiveWrite_;
+  int written = ++written_[bufferIdx(gen)];
+  int closed = closedSize_[bufferIdx(gen)];
+  bool ready = (closed > 0 && written == closed) || (gen == fillGen_ && written == nextSlot_);
   lk.unlock();
-  if (numActiveWrite_ == 0) {
+  if (ready) {
     cvGetBatch_.notify_one();
   }
   return FutureReply(reply, slot);
 }
 
-// get batch input from batcher
-TensorDict Batcher::get() {
-  std::unique_lock<std::mutex> lk(mNextSlot_);
-  cvGetBatch_.wait(
-      lk, [this] { return (nextSlot_ > 0 && numActiveWrite_ == 0) || exit_; });
+FutureReply Batcher::sendLockFree(const TensorDict& t) {
+  uint64_t s = state_.load(std::memory_order_acquire);
+  while (true) {
+    if (stateGen(s) >= freeGen_.load() + numBuffer_) {
+      // wait if every buffer of the ring is full and not released
+      auto begin = std::chrono::steady_clock::now();
+      {
+        std::unique_lock<std::mutex> lk(mNextSlot_);
+        cvNextSlot_.wait(lk, [this] {
+          return stateGen(state_.load()) < freeGen_.load() + numBuffer_;
+        });
+      }
+      auto end = std::chrono::steady_clock::now();
+      ++numStall_;
+      stallNs_ += std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+      s = state_.load(std::memory_order_acquire);
+      continue;
+    }
 
-  if (exit_) {
-    return TensorDict();
+    // the producer taking the last slot also closes the batch
+    uint64_t next = s + 1;
+    if (stateReserved(s) + 1 == batchsize_) {
+      next = (stateGen(s) + 1) << kGenShift;
+    }
+    if (state_.compare_exchange_weak(
+            s, next, std::memory_order_acq_rel, std::memory_order_acquire)) {
+      break;
+    }
   }
 
-  int bsize = nextSlot_;
-  nextSlot_ = 0;
-  // assert previous reply has been handled
-  assert(filledReply_ == nullptr);
-  std::swap(fillingBuffer_, filledBuffer_);
-  std::swap(fillingReply_, filledReply_);
-  fillingReply_ = std::make_shared<FutureReply_>();
+  uint64_t gen = stateGen(s);
+  int slot = stateReserved(s);
+  int idx = bufferIdx(gen);
+  if (slot == 0) {
+    firstSendNs_[idx] = Clock::now().time_since_epoch().count();
+  }
+  if (slot + 1 == batchsize_) {
+    onClose(gen, batchsize_);
+  }
+  // published by set() before freeGen_ was advanced
+  auto reply = replies_[idx];
+  assert(reply != nullptr);
 
-  lk.unlock();
-  cvNextSlot_.notify_all();
+  write(t, gen, slot);
+
+  // a batch cannot be taken while one of its writes is pending
+  int written = written_[idx].fetch_add(1) + 1;
+  if (numWaiting_.load() > 0) {
+    int closed = closedSize_[idx].load();
+    uint64_t cur = state_.load();
+    bool ready = (closed > 0 && written == closed) ||
+        (stateGen(cur) == gen && stateReserved(cur) == written);
+    if (ready) {
+      // runner is idle, lock to avoid missing its wait
+      { std::lock_guard<std::mutex> lk(mNextSlot_); }
+      cvGetBatch_.notify_one();
+    }
+  }
+  return FutureReply(reply, slot);
+}
+
+bool Batcher::policyAllows(int idx, int reserved, Clock::time_point* deadline) const {
+  if (reserved >= batchsize_) {
+    return true;
+  }
+
+  auto now = Clock::now();
+  int64_t firstNs = firstSendNs_[idx].load();
+  auto first = firstNs ? Clock::time_point(Clock::duration(firstNs)) : now;
+  auto waited = std::chrono::duration<double, std::micro>(now - first).count();
+
+  double maxWait = policy_.maxWaitUs > 0 ? policy_.maxWaitUs : -1;
+  if (maxWait >= 0 && waited >= maxWait) {
+    return true;
+  }
+
+  // leave room for the forward within the target latency
+  double budget = 0;
+  if (policy_.targetLatencyUs > 0) {
+    budget = std::max(0.0, policy_.targetLatencyUs - forwardUs_.load());
+    if (maxWait >= 0) {
+      budget = std::min(budget, maxWait);
+    }
+  }
+  if (reserved >= policy_.minBatchsize && waited >= budget) {
+    return true;
+  }
+
+  auto toDuration = [](double us) {
+    return std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double, std::micro>(us));
+  };
+  *deadline = Clock::time_point::max();
+  if (maxWait >= 0) {
+    *deadline = first + toDuration(maxWait);
+  }
+  if (reserved >= policy_.minBatchsize) {
+    *deadline = std::min(*deadline, first + toDuration(budget));
+  }
+  return false;
+}
+
+bool Batcher::tryTake(uint64_t* gen, int* bsize, Clock::time_point* deadline) {
+  uint64_t g = readGen_;
+  int idx = bufferIdx(g);
+  uint64_t fillGen = lockFree_ ? stateGen(state_.load()) : fillGen_;
+  assert(g <= fillGen);
+
+  if (g < fillGen) {
+    // closed by a producer, wait for the remaining writes
+    int closed = closedSize_[idx].load();
+    if (closed == 0 || written_[idx].load() != closed) {
+      return false;
+    }
+    *bsize = closed;
+  } else if (lockFree_) {
+    uint64_t s = state_.load();
+    int reserved = stateReserved(s);
+    if (reserved == 0 || written_[idx].load() != reserved) {
+      return false;
+    }
+    if (!policyAllows(idx, reserved, deadline)) {
+      return false;
+    }
+    // fails if a producer reserved a new slot in between
+    if (!state_.compare_exchange_strong(s, (g + 1) << kGenShift)) {
+      return false;
+    }
+    onClose(g, reserved);
+    *bsize = reserved;
+  } else {
+    if (nextSlot_ == 0 || written_[idx].load() != nextSlot_) {
+      return false;
+    }
+    if (!policyAllows(idx, nextSlot_, deadline)) {
+      return false;
+    }
+    onClose(g, nextSlot_);
+    *bsize = nextSlot_;
+    ++fillGen_;
+    nextSlot_ = 0;
+  }
+
+  *gen = g;
+  ++readGen_;
+  return true;
+}
 
+// get batch input from batcher
+TensorDict Batcher::get(int64_t* gen) {
+  assert(gen != nullptr);
+  uint64_t g = 0;
+  int bsize = 0;
+  {
+    std::unique_lock<std::mutex> lk(mNextSlot_);
+    while (true) {
+      if (exit_) {
+        return TensorDict();
+      }
+      auto deadline = Clock::time_point::max();
+      if (tryTake(&g, &bsize, &deadline)) {
+        break;
+      }
+      ++numWaiting_;
+      // check again now that producers will notify us
+      if (tryTake(&g, &bsize, &deadline)) {
+        --numWaiting_;
+        break;
+      }
+      if (deadline == Clock::time_point::max()) {
+        cvGetBatch_.wait(lk);
+      } else {
+        cvGetBatch_.wait_until(lk, deadline);
+      }
+      --numWaiting_;
+    }
+  }
+  *gen = (int64_t)g;
+  int idx = bufferIdx(g);
+  int64_t takeNs = Clock::now().time_since_epoch().count();
+  queueWaitUs_.add((takeNs - closeNs_[idx].load()) * 1e-3);
+
+  // views are contiguous since the arena stores each key batch-major.
+  // they stay valid until set() is called for this generation, the
+  // earliest point at which producers can start to refill the buffer
   TensorDict batch;
-  for (const auto& kv : filledBuffer_) {
-    batch[kv.first] = kv.second.narrow(0, 0, bsize).contiguous();
+  if (device_.is_cpu()) {
+    for (const auto& kv : buffers_[idx]) {
+      batch[kv.first] = kv.second.narrow(0, 0, bsize);
+    }
+  } else {
+    // one copy for the whole arena, ordered before the forward on the stream
+    deviceArenas_[idx].copy_(arenas_[idx], /*non_blocking=*/true);
+    int64_t copyNs = Clock::now().time_since_epoch().count();
+    deviceCopyUs_.add((copyNs - takeNs) * 1e-3);
+    for (const auto& kv : deviceBuffers_[idx]) {
+      batch[kv.first] = kv.second.narrow(0, 0, bsize);
+    }
   }
 
   return batch;
 }
 
 // set batch reply for batcher
-void Batcher::set(TensorDict&& t) {
-  for (const auto& kv : t) {
+void Batcher::set(TensorDict&& t, int64_t gen) {
+  for (auto& kv : t) {
     assert(kv.second.device().is_cpu());
+    // the model may return (a view of) its input, which lives in the
+    // arena and is refilled while actors are still reading the reply
+    if (aliasesArena(kv.second)) {
+      kv.second = kv.second.clone();
+    }
+  }
+  replies_[bufferIdx(gen)]->set(std::move(t));
+  int64_t firstNs = firstSendNs_[bufferIdx(gen)].load();
+  if (firstNs > 0) {
+    int64_t now = Clock::now().time_since_epoch().count();
+    replyUs_.add((now - firstNs) * 1e-3);
+  }
+
+  bool advanced = false;
+  {
+    std::lock_guard<std::mutex> lk(mNextSlot_);
+    released_[bufferIdx(gen)] = true;
+    // buffers are reused in generation order
+    while (freeGen_ < readGen_ && released_[bufferIdx(freeGen_)]) {
+      int idx = bufferIdx(freeGen_);
+      released_[idx] = false;
+      written_[idx] = 0;
+      closedSize_[idx] = 0;
+      firstSendNs_[idx] = 0;
+      closeNs_[idx] = 0;
+      replies_[idx] = std::make_shared<FutureReply_>();
+      ++freeGen_;
+      advanced = true;
+    }
   }
-  filledReply_->set(std::move(t));
-  filledReply_ = nullptr;
+  if (advanced) {
+    cvNextSlot_.notify_all();
+  }
+}
+
+void Batcher::recordForward(double us) {
+  // exponential moving average, only runner threads write it
+  double prev = forwardUs_.load();
+  forwardUs_ = prev == 0 ? us : 0.9 * prev + 0.1 * us;
+  forwardHistUs_.add(us);
+}
+
+std::unordered_map<std::string, double> Batcher::getStats() const {
+  std::unordered_map<std::string, double> stats;
+  int64_t numClose = numClose_.load();
+  stats["num_buffer"] = numBuffer_;
+  stats["num_batch"] = numClose;
+  stats["avg_batchsize"] = numClose ? (double)aggSize_.load() / numClose : 0;
+  stats["forward_us"] = forwardUs_.load();
+  stats["avg_in_flight"] = numClose ? (double)aggInFlight_.load() / numClose : 0;
+  stats["num_stall"] = numStall_.load();
+  stats["stall_sec"] = stallNs_.load() * 1e-9;
+  return stats;
+}
+
+std::unordered_map<std::string, std::unordered_map<std::string, double>>
+Batcher::getHistograms() const {
+  std::unordered_map<std::string, std::unordered_map<std::string, double>> hists;
+  hists["fill_us"] = fillUs_.summary();
+  hists["queue_wait_us"] = queueWaitUs_.summary();
+  hists["device_copy_us"] = deviceCopyUs_.summary();
+  hists["forward_us"] = forwardHistUs_.summary();
+  hists["reply_us"] = replyUs_.summary();
+  hists["batchsize"] = batchsizeHist_.summary();
+  return hists;
+}
+
+void Batcher::resetHistograms() {
+  fillUs_.reset();
+  queueWaitUs_.reset();
+  deviceCopyUs_.reset();
+  forwardHistUs_.reset();
+  replyUs_.reset();
+  batchsizeHist_.reset();
 }
 }  // namespace rela
@@ -6,6 +6,13 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+#include "rela/histogram.h"
+#include "rela/ready_queue.h"
 #include "rela/tensor_dict.h"
 #include "rela/utils.h"
 
@@ -14,6 +21,11 @@ namespace rela {
 std::vector<int64_t> getBatchedSize(torch::Tensor t, int bsz);
 TensorDict allocateBatchStorage(const TensorDict& data, int bsz);
 
+// size in bytes of a uint8 arena holding [bsz, ...] for every key of data
+int64_t batchArenaBytes(const TensorDict& data, int bsz);
+// per key [bsz, ...] views into a contiguous arena, keys are laid out back to back
+TensorDict viewBatchArena(const TensorDict& data, int bsz, const torch::Tensor& arena);
+
 class FutureReply_;
 
 class FutureReply {
@@ -36,6 +48,9 @@ class FutureReply {
     return fut_ == nullptr;
   }
 
+  // push tag onto queue once the reply is set (right away if it already is)
+  void notifyOnReady(std::shared_ptr<ReadyQueue> queue, int tag) const;
+
  private:
   std::shared_ptr<FutureReply_> fut_;
   int slot;
@@ -43,9 +58,50 @@ class FutureReply {
 
 using Future = FutureReply;
 
+// When the runner may fire a batch that is not full yet. The first request
+// of a batch waits at most maxWaitUs (<= 0: no cap). Below minBatchsize the
+// batch only fires once maxWaitUs is reached. If targetLatencyUs > 0 the
+// batch additionally waits for more requests as long as the wait plus the
+// measured forward time stays within the target. The default fires any
+// non-empty batch as soon as its writes are done.
+struct BatchPolicy {
+  BatchPolicy() = default;
+
+  BatchPolicy(int minBatchsize, int maxWaitUs, int targetLatencyUs)
+      : minBatchsize(minBatchsize)
+      , maxWaitUs(maxWaitUs)
+      , targetLatencyUs(targetLatencyUs) {
+  }
+
+  int minBatchsize = 1;
+  int maxWaitUs = 0;
+  int targetLatencyUs = 0;
+};
+
+// Batcher owns a ring of numBuffer batch buffers indexed by a generation
+// counter: producers fill buffer[gen % numBuffer], a full batch is closed
+// right away and producers move on to the next generation, so they keep
+// filling while earlier batches are still evaluated. A buffer is reused
+// once set() has been called for it, producers stall only when every buffer
+// of the ring is in use.
+//
+// In the default mode slots are reserved under mNextSlot_. With
+// lockFree=true the filling generation and its number of reserved slots are
+// packed into one atomic word, and producers only touch a mutex when the
+// ring is full or a runner is idle waiting for the last write.
+//
+// Several runner threads may call get()/set() concurrently.
+//
+// Each buffer is a single contiguous arena (pinned if device is not cpu) so
+// get() hands out views without copying, plus one async copy to the device.
 class Batcher {
  public:
-  Batcher(int batchsize);
+  Batcher(
+      int batchsize,
+      bool lockFree = false,
+      const torch::Device& device = torch::Device(torch::kCPU),
+      int numBuffer = 2,
+      const BatchPolicy& policy = BatchPolicy());
 
   Batcher(const Batcher&) = delete;
   Batcher& operator=(const Batcher&) = delete;
@@ -66,29 +122,139 @@ class Batcher {
     return exit_;
   }
 
+  bool lockFree() const {
+    return lockFree_;
+  }
+
   // send data into batcher
   FutureReply send(const TensorDict& t);
 
-  // get batch input from batcher
-  TensorDict get();
+  // get batch input from batcher, gen identifies the batch for set()
+  TensorDict get(int64_t* gen);
 
   // set batch reply for batcher
-  void set(TensorDict&& t);
+  void set(TensorDict&& t, int64_t gen);
+
+  // feed the measured forward time to the target latency controller
+  void recordForward(double us);
+
+  // num_batch: #batches closed, avg_batchsize, forward_us: smoothed forward
+  // time seen by the policy, avg_in_flight: avg #batches closed but not
+  // yet set() when a batch is closed (overlap between filling and
+  // evaluation), num_stall/stall_sec: producer waits on a full ring
+  std::unordered_map<std::string, double> getStats() const;
+
+  // summary of each latency histogram (in us) and of the batch sizes:
+  // fill_us: first send -> batch closed, queue_wait_us: closed -> taken by
+  // a runner, device_copy_us: enqueueing the host to device copy,
+  // forward_us: as recorded by the runner, reply_us: first send -> reply
+  // set, batchsize
+  std::unordered_map<std::string, std::unordered_map<std::string, double>>
+  getHistograms() const;
+
+  void resetHistograms();
 
  private:
+  // layout of state_ in lock free mode: [gen:32 | reserved:32], gen holds
+  // the low 32 bits of the generation and wraps around
+  static constexpr int kGenShift = 32;
+  static constexpr uint64_t kReservedMask = 0xffffffff;
+
+  // full generation of s. it is never more than numBuffer_ ahead of
+  // freeGen_ and a stale s is only a few generations behind, so the low 32
+  // bits are rebuilt as a signed offset from freeGen_
+  uint64_t stateGen(uint64_t s) const {
+    uint64_t base = freeGen_.load();
+    int32_t delta = (int32_t)((uint32_t)(s >> kGenShift) - (uint32_t)base);
+    return base + (int64_t)delta;
+  }
+
+  static int stateReserved(uint64_t s) {
+    return (int)(s & kReservedMask);
+  }
+
+  int bufferIdx(uint64_t gen) const {
+    return (int)(gen % numBuffer_);
+  }
+
+  void initBuffer(const TensorDict& t);
+
+  void write(const TensorDict& t, uint64_t gen, int slot);
+
+  bool aliasesArena(const torch::Tensor& t) const;
+
+  FutureReply sendLocked(const TensorDict& t);
+
+  FutureReply sendLockFree(const TensorDict& t);
+
+  // book-keeping after gen has been closed with size slots
+  void onClose(uint64_t gen, int size);
+
+  using Clock = std::chrono::steady_clock;
+
+  // whether the policy lets the filling batch fire with reserved slots now,
+  // otherwise deadline is set to the time at which it will
+  bool policyAllows(int idx, int reserved, Clock::time_point* deadline) const;
+
+  // with mNextSlot_ held, take the oldest closed batch or close the filling
+  // one if all its writes are done and the policy allows it. returns false
+  // if nothing is ready, deadline tells when to check again
+  bool tryTake(uint64_t* gen, int* bsize, Clock::time_point* deadline);
+
   const int batchsize_;
+  const bool lockFree_;
+  const torch::Device device_;
+  const int numBuffer_;
+  const BatchPolicy policy_;
+  std::atomic<double> forwardUs_{0};
 
+  // lock mode, protected by mNextSlot_
+  uint64_t fillGen_;
   int nextSlot_;
-  int numActiveWrite_;
-  std::condition_variable cvNextSlot_;
 
-  TensorDict fillingBuffer_;
-  std::shared_ptr<FutureReply_> fillingReply_;
+  // lock free mode
+  std::atomic<uint64_t> state_;
+  // #runner threads waiting in get()
+  std::atomic<int> numWaiting_{0};
 
-  TensorDict filledBuffer_;
-  std::shared_ptr<FutureReply_> filledReply_;
+  // per buffer, reset when the buffer is released
+  std::unique_ptr<std::atomic<int>[]> written_;
+  std::unique_ptr<std::atomic<int>[]> closedSize_;
+  // steady clock ns of the first send, 0 if not yet known
+  std::unique_ptr<std::atomic<int64_t>[]> firstSendNs_;
+  // steady clock ns at which the batch was closed
+  std::unique_ptr<std::atomic<int64_t>[]> closeNs_;
+  std::vector<std::shared_ptr<FutureReply_>> replies_;
+  // protected by mNextSlot_
+  std::vector<bool> released_;
 
-  bool exit_ = false;
+  // next generation handed out by get(), protected by mNextSlot_
+  uint64_t readGen_;
+  // generations < freeGen_ have been set(), written under mNextSlot_
+  std::atomic<uint64_t> freeGen_;
+
+  std::once_flag initBuffer_;
+  std::vector<torch::Tensor> arenas_;
+  std::vector<TensorDict> buffers_;
+  // only used if device_ is not cpu
+  std::vector<torch::Tensor> deviceArenas_;
+  std::vector<TensorDict> deviceBuffers_;
+
+  std::atomic<int64_t> numClose_{0};
+  std::atomic<int64_t> aggSize_{0};
+  std::atomic<int64_t> aggInFlight_{0};
+  std::atomic<int64_t> numStall_{0};
+  std::atomic<int64_t> stallNs_{0};
+
+  Histogram fillUs_ = Histogram::log();
+  Histogram queueWaitUs_ = Histogram::log();
+  Histogram deviceCopyUs_ = Histogram::log();
+  Histogram forwardHistUs_ = Histogram::log();
+  Histogram replyUs_ = Histogram::log();
+  Histogram batchsizeHist_;
+
+  std::atomic<bool> exit_{false};
+  std::condition_variable cvNextSlot_;
   std::condition_variable cvGetBatch_;
   std::mutex mNextSlot_;
 };
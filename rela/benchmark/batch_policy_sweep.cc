@@ -0,0 +1,107 @@
+// Latency/throughput sweep over rela::BatchPolicy.
+// Producers sleep thinkUs between requests like an env step, the runner
+// sleeps fixedUs + perSampleUs * bsz as a stand-in for the forward. For each
+// policy reports throughput, the average batch size, and the mean/p99
+// latency from send() until the reply is available.
+//
+// usage: batch_policy_sweep [numThread=64] [sendPerThread=500] [batchsize=256]
+//                           [thinkUs=50] [fixedUs=500] [perSampleUs=2]
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+#include "rela/batcher.h"
+
+using namespace rela;
+using Clock = std::chrono::steady_clock;
+
+int main(int argc, char** argv) {
+  int numThread = argc > 1 ? std::stoi(argv[1]) : 64;
+  int sendPerThread = argc > 2 ? std::stoi(argv[2]) : 500;
+  int batchsize = argc > 3 ? std::stoi(argv[3]) : 256;
+  int thinkUs = argc > 4 ? std::stoi(argv[4]) : 50;
+  int fixedUs = argc > 5 ? std::stoi(argv[5]) : 500;
+  int perSampleUs = argc > 6 ? std::stoi(argv[6]) : 2;
+  torch::set_num_threads(1);
+
+  // min batchsize, max wait us, target latency us
+  std::vector<BatchPolicy> policies = {
+      {1, 0, 0},
+      {numThread / 4, 0, 0},
+      {numThread / 2, 0, 0},
+      {numThread / 2, 200, 0},
+      {numThread / 2, 1000, 0},
+      {1, 0, 1000},
+      {1, 0, 2000},
+      {1, 2000, 4000},
+  };
+
+  std::cout << std::setw(6) << "min" << std::setw(8) << "wait" << std::setw(8)
+            << "target" << std::setw(12) << "send/s" << std::setw(10) << "avg_bsz"
+            << std::setw(12) << "mean_us" << std::setw(12) << "p99_us" << std::endl;
+  for (auto policy : policies) {
+    policy.minBatchsize = std::max(1, std::min(policy.minBatchsize, batchsize));
+    Batcher batcher(batchsize, false, torch::Device(torch::kCPU), 2, policy);
+
+    std::thread runner([&]() {
+      while (!batcher.terminated()) {
+        int64_t gen = -1;
+        auto batch = batcher.get(&gen);
+        if (batch.empty()) {
+          break;
+        }
+        auto begin = Clock::now();
+        int bsz = batch.at("s").size(0);
+        std::this_thread::sleep_for(std::chrono::microseconds(fixedUs + perSampleUs * bsz));
+        TensorDict reply;
+        reply["a"] = batch.at("s").sum(1);
+        batcher.recordForward(
+            std::chrono::duration<double, std::micro>(Clock::now() - begin).count());
+        batcher.set(std::move(reply), gen);
+      }
+    });
+
+    std::vector<std::vector<double>> latencies(numThread);
+    auto begin = Clock::now();
+    std::vector<std::thread> producers;
+    for (int i = 0; i < numThread; ++i) {
+      producers.emplace_back([&, i]() {
+        TensorDict input;
+        input["s"] = torch::ones({16});
+        for (int j = 0; j < sendPerThread; ++j) {
+          std::this_thread::sleep_for(std::chrono::microseconds(thinkUs));
+          auto sent = Clock::now();
+          batcher.send(input).get();
+          latencies[i].push_back(
+              std::chrono::duration<double, std::micro>(Clock::now() - sent).count());
+        }
+      });
+    }
+    for (auto& t : producers) {
+      t.join();
+    }
+    double sec = std::chrono::duration<double>(Clock::now() - begin).count();
+    batcher.exit();
+    runner.join();
+
+    std::vector<double> all;
+    for (auto& l : latencies) {
+      all.insert(all.end(), l.begin(), l.end());
+    }
+    std::sort(all.begin(), all.end());
+    double mean = 0;
+    for (auto l : all) {
+      mean += l / all.size();
+    }
+    auto stats = batcher.getStats();
+    std::cout << std::fixed << std::setprecision(0) << std::setw(6) << policy.minBatchsize
+              << std::setw(8) << policy.maxWaitUs << std::setw(8) << policy.targetLatencyUs
+              << std::setw(12) << all.size() / sec << std::setprecision(1) << std::setw(10)
+              << stats.at("avg_batchsize") << std::setprecision(0) << std::setw(12) << mean
+              << std::setw(12) << all[(size_t)(0.99 * (all.size() - 1))] << std::endl;
+  }
+  return 0;
+}
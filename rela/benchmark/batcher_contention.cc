@@ -0,0 +1,100 @@
+// Contention benchmark for rela::Batcher.
+// Every producer thread loops over send() + FutureReply::get() like an actor,
+// and a single runner thread echoes each batch back after sleeping forwardUs
+// to stand in for the model. Reports sends/sec against the number of
+// producer threads for the locked and lock free modes, together with the
+// overlap and producer stall time of the buffer ring.
+//
+// usage: batcher_contention [maxThread=256] [sendPerThread=2000] [batchsize=512]
+//                           [numBuffer=2] [forwardUs=0]
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+#include "rela/batcher.h"
+
+using namespace rela;
+
+struct Result {
+  double sendPerSec;
+  std::unordered_map<std::string, double> stats;
+};
+
+Result runOnce(
+    int numThread,
+    int sendPerThread,
+    int batchsize,
+    int numBuffer,
+    int forwardUs,
+    bool lockFree) {
+  Batcher batcher(batchsize, lockFree, torch::Device(torch::kCPU), numBuffer);
+
+  std::thread runner([&]() {
+    while (!batcher.terminated()) {
+      int64_t gen = -1;
+      auto batch = batcher.get(&gen);
+      if (batch.empty()) {
+        break;
+      }
+      if (forwardUs > 0) {
+        std::this_thread::sleep_for(std::chrono::microseconds(forwardUs));
+      }
+      TensorDict reply;
+      reply["a"] = batch.at("s").sum(1);
+      batcher.set(std::move(reply), gen);
+    }
+  });
+
+  auto begin = std::chrono::steady_clock::now();
+  std::vector<std::thread> producers;
+  for (int i = 0; i < numThread; ++i) {
+    producers.emplace_back([&, i]() {
+      TensorDict input;
+      input["s"] = torch::full({16}, (float)i);
+      for (int j = 0; j < sendPerThread; ++j) {
+        auto fut = batcher.send(input);
+        auto reply = fut.get();
+        assert(reply.at("a").item<float>() == 16.0f * i);
+      }
+    });
+  }
+  for (auto& t : producers) {
+    t.join();
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  batcher.exit();
+  runner.join();
+
+  double sec = std::chrono::duration<double>(end - begin).count();
+  return {(double)numThread * sendPerThread / sec, batcher.getStats()};
+}
+
+int main(int argc, char** argv) {
+  int maxThread = argc > 1 ? std::stoi(argv[1]) : 256;
+  int sendPerThread = argc > 2 ? std::stoi(argv[2]) : 2000;
+  int batchsize = argc > 3 ? std::stoi(argv[3]) : 512;
+  int numBuffer = argc > 4 ? std::stoi(argv[4]) : 2;
+  int forwardUs = argc > 5 ? std::stoi(argv[5]) : 0;
+  torch::set_num_threads(1);
+
+  std::cout << "batchsize: " << batchsize << ", #buffer: " << numBuffer
+            << ", forward: " << forwardUs << "us" << std::endl;
+  std::cout << std::setw(8) << "#thread" << std::setw(8) << "mode" << std::setw(14)
+            << "send/s" << std::setw(14) << "avg_in_flight" << std::setw(12)
+            << "stall_sec" << std::endl;
+  for (int numThread = 1; numThread <= maxThread; numThread *= 2) {
+    for (bool lockFree : {false, true}) {
+      auto result =
+          runOnce(numThread, sendPerThread, batchsize, numBuffer, forwardUs, lockFree);
+      std::cout << std::fixed << std::setw(8) << numThread << std::setw(8)
+                << (lockFree ? "free" : "lock") << std::setprecision(0)
+                << std::setw(14) << result.sendPerSec << std::setprecision(2)
+                << std::setw(14) << result.stats.at("avg_in_flight") << std::setw(12)
+                << result.stats.at("stall_sec") << std::endl;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,72 @@
+// I/O throughput of the replay disk tier (ColdStorage) on the disk holding
+// dir. Appends numEpisode episodes of seqLen steps with featDim float
+// features and waits for them to be written, then samples batches of
+// batchsize from the cache for readSec seconds while the loader refreshes
+// it from random chunks. Written chunks are dropped from the page cache, so
+// reads mostly hit the disk. Reports episodes/sec and MB/sec of both
+// phases, and the p99 latency of a batch sample.
+//
+// usage: cold_storage [dir=/tmp/rela_cold] [numEpisode=20000] [chunkSize=256]
+//                     [seqLen=80] [featDim=783] [batchsize=128] [readSec=5]
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+#include <sys/stat.h>
+
+#include "rela/benchmark/common.h"
+#include "rela/cold_storage.h"
+
+using namespace rela;
+using Clock = std::chrono::steady_clock;
+
+int main(int argc, char** argv) {
+  std::string dir = argc > 1 ? argv[1] : "/tmp/rela_cold";
+  int numEpisode = argc > 2 ? std::stoi(argv[2]) : 20000;
+  int chunkSize = argc > 3 ? std::stoi(argv[3]) : 256;
+  int seqLen = argc > 4 ? std::stoi(argv[4]) : 80;
+  int featDim = argc > 5 ? std::stoi(argv[5]) : 783;
+  int batchsize = argc > 6 ? std::stoi(argv[6]) : 128;
+  double readSec = argc > 7 ? std::stod(argv[7]) : 5;
+  torch::set_num_threads(1);
+  mkdir(dir.c_str(), 0755);
+
+  auto transition = makeTransition(seqLen, featDim);
+  ColdStorage cold(dir, numEpisode, chunkSize, 8 * chunkSize, 1);
+
+  auto begin = Clock::now();
+  for (int i = 0; i < numEpisode; ++i) {
+    cold.append(transition);
+  }
+  cold.flush();
+  double sec = std::chrono::duration<double>(Clock::now() - begin).count();
+  std::cout << std::fixed << std::setprecision(1) << "write: " << cold.size() / sec
+            << " eps/s, " << cold.bytesWritten() / sec / 1e6 << " MB/s, "
+            << cold.numDropped() << " chunks dropped" << std::endl;
+
+  while (cold.numCached() == 0) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  auto batch = RNNTransition(transition, 1).allocateSeqFirst(batchsize, false);
+  std::mt19937 rng(1);
+  std::vector<double> sampleUs;
+  int64_t bytesRead = cold.bytesRead();
+  begin = Clock::now();
+  while (std::chrono::duration<double>(Clock::now() - begin).count() < readSec) {
+    auto t0 = Clock::now();
+    cold.sampleSeqFirst(batchsize, rng, batch, 0);
+    sampleUs.push_back(std::chrono::duration<double, std::micro>(Clock::now() - t0).count());
+  }
+  sec = std::chrono::duration<double>(Clock::now() - begin).count();
+  bytesRead = cold.bytesRead() - bytesRead;
+  double bytesPerEpisode = (double)cold.bytesWritten() / cold.size();
+  std::sort(sampleUs.begin(), sampleUs.end());
+  std::cout << "read: " << bytesRead / bytesPerEpisode / sec << " eps/s, "
+            << bytesRead / sec / 1e6 << " MB/s, "
+            << sampleUs.size() * batchsize / sec << " sampled eps/s, p99 sample "
+            << sampleUs[(size_t)(0.99 * (sampleUs.size() - 1))] << " us" << std::endl;
+  return 0;
+}
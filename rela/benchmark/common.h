@@ -0,0 +1,20 @@
+// Helpers shared by the replay benchmarks.
+
+#pragma once
+
+#include "rela/transition.h"
+
+// an episode of seqLen steps with featDim float features, 21 legal moves
+// and the hidden state of a 2 layer, 512 wide LSTM
+inline rela::RNNTransition makeTransition(int seqLen, int featDim) {
+  rela::RNNTransition t;
+  t.obs["priv_s"] = torch::rand({seqLen, featDim});
+  t.obs["legal_move"] = torch::ones({seqLen, 21});
+  t.h0["h0"] = torch::rand({2, 512});
+  t.h0["c0"] = torch::rand({2, 512});
+  t.action["a"] = torch::randint(21, {seqLen}, torch::kInt64);
+  t.reward = torch::rand({seqLen});
+  t.bootstrap = torch::ones({seqLen});
+  t.seqLen = torch::tensor((float)seqLen);
+  return t;
+}
@@ -0,0 +1,88 @@
+// Per step cost of actor tracing. Each step builds an actor-like input
+// TensorDict and traces its shapes like R2D2Actor::observeBeforeAct used to:
+//   none:     no log statement, same as building with the default
+//             RELA_COMPILED_LOG_LEVEL
+//   filtered: RELA_TRACE compiled in but below the runtime level
+//   on:       RELA_TRACE compiled in and enabled
+//   cout:     the old per key std::cout << ... << std::endl tracing
+// numThread threads step concurrently since the stdout lock is the problem.
+// Log output goes to stdout, results to stderr:
+//
+// usage: log_overhead [numThread=8] [stepPerThread=20000] > /dev/null
+
+// compile the trace statements in regardless of the build setting
+#undef RELA_COMPILED_LOG_LEVEL
+#define RELA_COMPILED_LOG_LEVEL 0
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+#include "rela/logging.h"
+#include "rela/tensor_dict.h"
+
+using namespace rela;
+using Clock = std::chrono::steady_clock;
+
+static TensorDict makeInput() {
+  TensorDict input;
+  input["priv_s"] = torch::zeros({783});
+  input["publ_s"] = torch::zeros({658});
+  input["legal_move"] = torch::zeros({21});
+  input["priv_s_text"] = torch::zeros({196}, torch::kInt64);
+  input["eps"] = torch::zeros({1});
+  input["h0"] = torch::zeros({2, 512});
+  input["c0"] = torch::zeros({2, 512});
+  return input;
+}
+
+static void step(int mode, int playerIdx) {
+  auto input = makeInput();
+  if (mode == 1 || mode == 2) {
+    RELA_TRACE("R2D2Actor::observeBeforeAct() player: " << playerIdx);
+    RELA_TRACE("  act input:\n" << tensor_dict::shapeString(input, "    "));
+  } else if (mode == 3) {
+    std::cout << "R2D2Actor::observeBeforeAct() - Player " << playerIdx << std::endl;
+    std::cout << "  After addHid, input TensorDict size: " << input.size() << std::endl;
+    for (const auto& kv : input) {
+      std::cout << "    Key: " << kv.first << ", Shape: [";
+      for (int i = 0; i < kv.second.dim(); ++i) {
+        if (i > 0) std::cout << ", ";
+        std::cout << kv.second.size(i);
+      }
+      std::cout << "]" << std::endl;
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  int numThread = argc > 1 ? std::stoi(argv[1]) : 8;
+  int stepPerThread = argc > 2 ? std::stoi(argv[2]) : 20000;
+  torch::set_num_threads(1);
+
+  const char* names[] = {"none", "filtered", "on", "cout"};
+  std::cerr << std::setw(10) << "mode" << std::setw(14) << "ns/step" << std::setw(14)
+            << "steps/s" << std::endl;
+  for (int mode = 0; mode < 4; ++mode) {
+    logging::setLevel(mode == 2 ? kTrace : kInfo);
+    auto begin = Clock::now();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < numThread; ++t) {
+      threads.emplace_back([=]() {
+        for (int i = 0; i < stepPerThread; ++i) {
+          step(mode, t);
+        }
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    double sec = std::chrono::duration<double>(Clock::now() - begin).count();
+    double numStep = (double)numThread * stepPerThread;
+    std::cerr << std::setw(10) << names[mode] << std::fixed << std::setprecision(0)
+              << std::setw(14) << sec * 1e9 * numThread / numStep << std::setw(14)
+              << numStep / sec << std::endl;
+  }
+  return 0;
+}
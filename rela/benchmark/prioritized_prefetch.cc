@@ -0,0 +1,107 @@
+// Sampling latency of PrioritizedReplay seen by the trainer, without and
+// with prefetch. An actor thread keeps adding episodes of seqLen steps
+// with featDim float features while the trainer samples numRound batches,
+// spends trainUs per batch as a stand-in for the training step and updates
+// their priorities, so updates regularly hit popped or replaced ids.
+// Reports the mean and p99 latency of sample() for prefetch 0, 1 and 4.
+// Finally terminates a replay while sample() waits for its sampler thread
+// and checks that it throws instead of hanging; exits with 1 otherwise.
+//
+// usage: prioritized_prefetch [capacity=4000] [batchsize=128] [numRound=200]
+//                             [trainUs=2000] [seqLen=80] [featDim=256]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+#include "rela/benchmark/common.h"
+#include "rela/prioritized_replay.h"
+
+using namespace rela;
+using Clock = std::chrono::steady_clock;
+
+// adds transition until stopped, add() returns at once after terminate()
+static std::thread startActor(
+    RNNPrioritizedReplay& replay, const RNNTransition& transition, std::atomic<bool>& stop) {
+  return std::thread([&replay, &transition, &stop]() {
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> dist(0.1, 1);
+    while (!stop) {
+      replay.add(transition, dist(rng));
+    }
+  });
+}
+
+int main(int argc, char** argv) {
+  int capacity = argc > 1 ? std::stoi(argv[1]) : 4000;
+  int batchsize = argc > 2 ? std::stoi(argv[2]) : 128;
+  int numRound = argc > 3 ? std::stoi(argv[3]) : 200;
+  int trainUs = argc > 4 ? std::stoi(argv[4]) : 2000;
+  int seqLen = argc > 5 ? std::stoi(argv[5]) : 80;
+  int featDim = argc > 6 ? std::stoi(argv[6]) : 256;
+  torch::set_num_threads(1);
+
+  auto transition = makeTransition(seqLen, featDim);
+  std::cout << std::setw(10) << "prefetch" << std::setw(16) << "mean_sample_us"
+            << std::setw(16) << "p99_sample_us" << std::endl;
+  for (int prefetch : {0, 1, 4}) {
+    RNNPrioritizedReplay replay(capacity, 1, 0.9, 0.4, prefetch);
+    for (int i = 0; i < capacity; ++i) {
+      replay.add(transition, 1);
+    }
+    std::atomic<bool> stop{false};
+    auto actor = startActor(replay, transition, stop);
+
+    std::vector<double> sampleUs;
+    for (int i = 0; i < numRound; ++i) {
+      auto begin = Clock::now();
+      auto batch = std::get<0>(replay.sample(batchsize, "cpu"));
+      sampleUs.push_back(
+          std::chrono::duration<double, std::micro>(Clock::now() - begin).count());
+      std::this_thread::sleep_for(std::chrono::microseconds(trainUs));
+      replay.updatePriority(torch::rand({batchsize}) + 0.1);
+    }
+    stop = true;
+    replay.terminate();
+    actor.join();
+
+    double mean = 0;
+    for (double us : sampleUs) {
+      mean += us / sampleUs.size();
+    }
+    std::sort(sampleUs.begin(), sampleUs.end());
+    std::cout << std::fixed << std::setprecision(0) << std::setw(10) << prefetch
+              << std::setw(16) << mean << std::setw(16)
+              << sampleUs[(size_t)(0.99 * (sampleUs.size() - 1))] << std::endl;
+  }
+
+  // without a training step the trainer outruns the sampler thread and
+  // mostly waits in sample() when the replay is terminated
+  RNNPrioritizedReplay replay(capacity, 1, 0.9, 0.4, 1);
+  for (int i = 0; i < capacity; ++i) {
+    replay.add(transition, 1);
+  }
+  auto trainer = std::async(std::launch::async, [&replay, batchsize]() {
+    try {
+      while (true) {
+        replay.sample(batchsize, "cpu");
+        replay.updatePriority(torch::rand({batchsize}) + 0.1);
+      }
+    } catch (const std::runtime_error&) {
+      return true;
+    }
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  replay.terminate();
+  if (trainer.wait_for(std::chrono::seconds(10)) != std::future_status::ready) {
+    std::cout << "sample() still blocked 10s after terminate()" << std::endl;
+    std::_Exit(1);
+  }
+  trainer.get();
+  std::cout << "terminate() unblocked sample()" << std::endl;
+  return 0;
+}
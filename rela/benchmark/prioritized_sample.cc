@@ -0,0 +1,102 @@
+// Stratified prioritized sampling: linear prefix scan (the old
+// PrioritizedReplay::sample_) vs rela::SumTree. Both index capacity random
+// weights, every round draws batchsize samples and then updates their
+// priorities like updatePriority() does. Reports the mean latency of the
+// sampling and of the update per batch.
+//
+// usage: prioritized_sample [capacity=1000000] [batchsize=128] [numRound=200]
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "rela/sum_tree.h"
+
+using namespace rela;
+using Clock = std::chrono::steady_clock;
+
+// the loop of the old sample_, without the storage access
+static void linearSample(
+    const std::vector<float>& weights,
+    double sum,
+    int batchsize,
+    std::mt19937& rng,
+    std::vector<int>& ids) {
+  float segment = sum / batchsize;
+  std::uniform_real_distribution<float> dist(0.0, segment);
+  double accSum = 0;
+  int nextIdx = 0;
+  for (int i = 0; i < batchsize; i++) {
+    float rand = std::min((float)sum - (float)0.1, dist(rng) + i * segment);
+    while (nextIdx < (int)weights.size() && !(accSum > 0 && accSum >= rand)) {
+      accSum += weights[nextIdx];
+      ++nextIdx;
+    }
+    ids[i] = nextIdx - 1;
+  }
+}
+
+int main(int argc, char** argv) {
+  int capacity = argc > 1 ? std::stoi(argv[1]) : 1000000;
+  int batchsize = argc > 2 ? std::stoi(argv[2]) : 128;
+  int numRound = argc > 3 ? std::stoi(argv[3]) : 200;
+
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<float> prio(0.01, 2.0);
+  std::vector<float> weights(capacity);
+  SumTree tree(capacity);
+  double sum = 0;
+  for (int i = 0; i < capacity; ++i) {
+    weights[i] = prio(rng);
+    sum += weights[i];
+    tree.set(i, weights[i]);
+  }
+
+  std::vector<int> ids(batchsize);
+  double linearSampleUs = 0;
+  double linearUpdateUs = 0;
+  for (int r = 0; r < numRound; ++r) {
+    auto t0 = Clock::now();
+    linearSample(weights, sum, batchsize, rng, ids);
+    auto t1 = Clock::now();
+    // the old update adjusted a running sum by the difference
+    for (int id : ids) {
+      float w = prio(rng);
+      sum += w - weights[id];
+      weights[id] = w;
+    }
+    auto t2 = Clock::now();
+    linearSampleUs += std::chrono::duration<double, std::micro>(t1 - t0).count();
+    linearUpdateUs += std::chrono::duration<double, std::micro>(t2 - t1).count();
+  }
+
+  double treeSampleUs = 0;
+  double treeUpdateUs = 0;
+  for (int r = 0; r < numRound; ++r) {
+    auto t0 = Clock::now();
+    double segment = tree.sum() / batchsize;
+    std::uniform_real_distribution<double> dist(0.0, segment);
+    for (int i = 0; i < batchsize; ++i) {
+      ids[i] = tree.find(dist(rng) + i * segment);
+    }
+    auto t1 = Clock::now();
+    for (int id : ids) {
+      tree.set(id, prio(rng));
+    }
+    auto t2 = Clock::now();
+    treeSampleUs += std::chrono::duration<double, std::micro>(t1 - t0).count();
+    treeUpdateUs += std::chrono::duration<double, std::micro>(t2 - t1).count();
+  }
+
+  std::cout << "capacity: " << capacity << ", batchsize: " << batchsize << std::endl;
+  std::cout << std::setw(10) << "index" << std::setw(14) << "sample_us" << std::setw(14)
+            << "update_us" << std::endl;
+  std::cout << std::fixed << std::setprecision(1);
+  std::cout << std::setw(10) << "linear" << std::setw(14) << linearSampleUs / numRound
+            << std::setw(14) << linearUpdateUs / numRound << std::endl;
+  std::cout << std::setw(10) << "sum_tree" << std::setw(14) << treeSampleUs / numRound
+            << std::setw(14) << treeUpdateUs / numRound << std::endl;
+  return 0;
+}
@@ -0,0 +1,103 @@
+// End-to-end Replay::sample() time for the two storage layouts:
+//   batch_major: [capacity, T, ...] storage, every sampled batch is
+//                transposed into [T, batchsize, ...] while it is gathered
+//   seq_first:   [T, capacity, ...] storage, batches are gathered in the
+//                learner layout directly
+//   ragged:      only the valid steps of each episode in a step arena,
+//                padding is materialized when sampling
+// The replay is filled with capacity R2D2 sized transitions whose seqLen is
+// uniform in [minLen, seqLen], sampling runs synchronously (prefetch 0) on
+// the calling thread plus numGatherThread. Also reports the storage size
+// and the time to add an episode. Padded storage is about 0.75MB per
+// transition at the default sizes.
+//
+// usage: replay_layout [capacity=2000] [batchsize=128] [seqLen=80]
+//                      [numGatherThread=0] [numRound=50] [minLen=30]
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+#include "rela/benchmark/common.h"
+#include "rela/replay.h"
+
+using namespace rela;
+using Clock = std::chrono::steady_clock;
+
+// R2D2 sized obs, including the public features and the text tokens
+static RNNTransition makeR2D2Transition(int seqLen) {
+  auto t = makeTransition(seqLen, 783);
+  t.obs["publ_s"] = torch::rand({seqLen, 658});
+  t.obs["priv_s_text"] = torch::randint(30000, {seqLen, 196}, torch::kInt64);
+  return t;
+}
+
+int main(int argc, char** argv) {
+  int capacity = argc > 1 ? std::stoi(argv[1]) : 2000;
+  int batchsize = argc > 2 ? std::stoi(argv[2]) : 128;
+  int seqLen = argc > 3 ? std::stoi(argv[3]) : 80;
+  int numGatherThread = argc > 4 ? std::stoi(argv[4]) : 0;
+  int numRound = argc > 5 ? std::stoi(argv[5]) : 50;
+  int minLen = argc > 6 ? std::stoi(argv[6]) : 30;
+  torch::set_num_threads(1);
+
+  auto transition = makeR2D2Transition(seqLen);
+  std::mt19937 rng(1);
+  std::uniform_int_distribution<int> lenDist(minLen, seqLen);
+  std::vector<int> lens(capacity);
+  int numStep = 0;
+  for (auto& len : lens) {
+    len = lenDist(rng);
+    numStep += len;
+  }
+
+  std::cout << "capacity: " << capacity << ", batchsize: " << batchsize
+            << ", seqLen: " << seqLen << ", numGatherThread: " << numGatherThread
+            << ", avg len: " << (double)numStep / capacity << std::endl;
+  std::cout << std::setw(12) << "layout" << std::setw(14) << "storage_MB" << std::setw(14)
+            << "add_us" << std::setw(14) << "sample_ms" << std::setw(14) << "GB/s"
+            << std::endl;
+
+  const char* names[] = {"batch_major", "seq_first", "ragged"};
+  for (int layout = 0; layout < 3; ++layout) {
+    Replay replay(capacity, 1, 0, numGatherThread, layout == 1, layout == 2 ? numStep : 0);
+    auto addBegin = Clock::now();
+    for (int i = 0; i < capacity; ++i) {
+      transition.seqLen.fill_((float)lens[i]);
+      replay.add(transition);
+    }
+    double addUs =
+        std::chrono::duration<double, std::micro>(Clock::now() - addBegin).count() / capacity;
+    // storage is 1.25 x capacity
+    double storageMB = replay.bytesPerEpisode() * 1.25 * capacity / 1e6;
+
+    int64_t bytes = 0;
+    double ms = 0;
+    for (int r = 0; r < numRound + 1; ++r) {
+      auto begin = Clock::now();
+      auto batch = replay.sample(batchsize, "cpu");
+      double roundMs = std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+      // first round warms up the allocator
+      if (r == 0) {
+        continue;
+      }
+      ms += roundMs;
+      for (auto& kv : batch.obs) {
+        bytes += kv.second.nbytes();
+      }
+      for (auto& kv : batch.h0) {
+        bytes += kv.second.nbytes();
+      }
+      for (auto& kv : batch.action) {
+        bytes += kv.second.nbytes();
+      }
+      bytes += batch.reward.nbytes() + batch.bootstrap.nbytes() + batch.seqLen.nbytes();
+    }
+    std::cout << std::setw(12) << names[layout] << std::fixed << std::setprecision(2)
+              << std::setw(14) << storageMB << std::setw(14) << addUs << std::setw(14)
+              << ms / numRound << std::setw(14) << bytes / ms / 1e6
+              << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,91 @@
+// Replay::add throughput against the number of writer threads, for a single
+// ConcurrentQueue and for one shard per writer, with episodes appended one
+// by one and through per thread staging blocks of staging episodes. Each writer adds
+// numAddPerWriter episodes of seqLen steps with featDim float features; the
+// replay is sized to hold all of them so that no add waits for a pop.
+// Reports episodes/sec and the p99 latency of a single add.
+//
+// usage: replay_shard [maxWriter=16] [numAddPerWriter=500] [seqLen=80]
+//                     [featDim=256] [staging=16]
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+#include "rela/benchmark/common.h"
+#include "rela/replay.h"
+
+using namespace rela;
+using Clock = std::chrono::steady_clock;
+
+int main(int argc, char** argv) {
+  int maxWriter = argc > 1 ? std::stoi(argv[1]) : 16;
+  int numAddPerWriter = argc > 2 ? std::stoi(argv[2]) : 500;
+  int seqLen = argc > 3 ? std::stoi(argv[3]) : 80;
+  int featDim = argc > 4 ? std::stoi(argv[4]) : 256;
+  int staging = argc > 5 ? std::stoi(argv[5]) : 16;
+  torch::set_num_threads(1);
+
+  auto transition = makeTransition(seqLen, featDim);
+  std::cout << std::setw(10) << "writers" << std::setw(10) << "shards" << std::setw(10)
+            << "staging" << std::setw(14) << "eps/s" << std::setw(14) << "p99_add_us"
+            << std::endl;
+  for (int numWriter = 1; numWriter <= maxWriter; numWriter *= 2) {
+    // (numShard, staging)
+    std::vector<std::pair<int, int>> configs = {{1, 1}, {1, staging}};
+    if (numWriter > 1) {
+      configs.push_back({numWriter, 1});
+      configs.push_back({numWriter, staging});
+    }
+    for (auto config : configs) {
+      int numShard = config.first;
+      int capacity = numWriter * numAddPerWriter;
+      Replay replay(capacity, 1, 0, 0, false, 0, numShard);
+      replay.setStagingSize(config.second);
+      // allocate the storage outside of the timed section. threads started
+      // together get consecutive slots, i.e. different shards
+      std::vector<std::thread> threads;
+      for (int i = 0; i < numWriter; ++i) {
+        threads.emplace_back([&]() { replay.add(transition); });
+      }
+      for (auto& t : threads) {
+        t.join();
+      }
+      replay.flushStaged();
+      threads.clear();
+
+      std::vector<std::vector<double>> addUs(numWriter);
+      auto begin = Clock::now();
+      for (int i = 0; i < numWriter; ++i) {
+        threads.emplace_back([&, i]() {
+          auto& us = addUs[i];
+          // the warm up add above used one slot of each writer
+          for (int j = 0; j < numAddPerWriter - 1; ++j) {
+            auto t0 = Clock::now();
+            replay.add(transition);
+            us.push_back(std::chrono::duration<double, std::micro>(Clock::now() - t0).count());
+          }
+        });
+      }
+      for (auto& t : threads) {
+        t.join();
+      }
+      replay.flushStaged();
+      double sec = std::chrono::duration<double>(Clock::now() - begin).count();
+
+      std::vector<double> all;
+      for (auto& us : addUs) {
+        all.insert(all.end(), us.begin(), us.end());
+      }
+      std::sort(all.begin(), all.end());
+      double p99 = all.empty() ? 0 : all[(size_t)(0.99 * (all.size() - 1))];
+      std::cout << std::setw(10) << numWriter << std::setw(10) << numShard
+                << std::setw(10) << config.second << std::fixed
+                << std::setprecision(0) << std::setw(14) << all.size() / sec
+                << std::setprecision(1) << std::setw(14) << p99 << std::endl;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,189 @@
+// Static env partitioning vs rela::WorkStealingExecutor.
+// Each synthetic env plays episodes of episodeLen steps. A step spins for
+// stepUs (slowFactor * stepUs for the first numSlowEnv envs, which like eval
+// games or belief calls end up on the same threads under a static split)
+// and then waits for the reply of a Batcher whose runner sleeps forwardUs per
+// batch. Static mode runs numThread executors of one worker over a fixed
+// slice each, which is what HanabiThreadLoop does. Reports games/sec and
+// the p50/p99 episode latency.
+//
+// usage: work_stealing [numThread=8] [numEnvPerThread=32] [numSlowEnv=64]
+//                      [slowFactor=8] [stepUs=20] [forwardUs=300]
+//                      [episodeLen=80] [durationSec=5]
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+#include "rela/batcher.h"
+#include "rela/work_stealing.h"
+
+using namespace rela;
+using Clock = std::chrono::steady_clock;
+
+static void spin(int us) {
+  auto end = Clock::now() + std::chrono::microseconds(us);
+  while (Clock::now() < end) {
+  }
+}
+
+class SyntheticEnvs : public TaskSet {
+ public:
+  SyntheticEnvs(
+      Batcher& batcher, int begin, int end, int numSlowEnv, int slowFactor,
+      int stepUs, int episodeLen)
+      : batcher_(batcher)
+      , begin_(begin)
+      , numSlowEnv_(numSlowEnv)
+      , slowFactor_(slowFactor)
+      , stepUs_(stepUs)
+      , episodeLen_(episodeLen)
+      , futures_(end - begin)
+      , stepCount_(end - begin, 0)
+      , episodeBegin_(end - begin, Clock::now())
+      , episodeUs_(end - begin) {
+    input_["s"] = torch::ones({16});
+  }
+
+  virtual int size() const override {
+    return (int)futures_.size();
+  }
+
+  virtual void setReadyQueue(std::shared_ptr<ReadyQueue> queue) override {
+    queue_ = std::move(queue);
+  }
+
+  virtual bool step(int i) override {
+    auto& fut = futures_[i];
+    if (!fut.isNull()) {
+      if (!fut.isReady()) {
+        return false;
+      }
+      fut.get();
+    }
+
+    if (++stepCount_[i] == episodeLen_) {
+      auto now = Clock::now();
+      episodeUs_[i].push_back(
+          std::chrono::duration<double, std::micro>(now - episodeBegin_[i]).count());
+      stepCount_[i] = 0;
+      episodeBegin_[i] = now;
+    }
+
+    spin(begin_ + i < numSlowEnv_ ? stepUs_ * slowFactor_ : stepUs_);
+    fut = batcher_.send(input_);
+    fut.notifyOnReady(queue_, i);
+    return true;
+  }
+
+  // call after all workers are joined
+  void collect(std::vector<double>& episodeUs) const {
+    for (const auto& v : episodeUs_) {
+      episodeUs.insert(episodeUs.end(), v.begin(), v.end());
+    }
+  }
+
+ private:
+  Batcher& batcher_;
+  const int begin_;
+  const int numSlowEnv_;
+  const int slowFactor_;
+  const int stepUs_;
+  const int episodeLen_;
+  TensorDict input_;
+  std::shared_ptr<ReadyQueue> queue_;
+
+  std::vector<FutureReply> futures_;
+  std::vector<int> stepCount_;
+  std::vector<Clock::time_point> episodeBegin_;
+  std::vector<std::vector<double>> episodeUs_;
+};
+
+int main(int argc, char** argv) {
+  int numThread = argc > 1 ? std::stoi(argv[1]) : 8;
+  int numEnvPerThread = argc > 2 ? std::stoi(argv[2]) : 32;
+  int numSlowEnv = argc > 3 ? std::stoi(argv[3]) : 64;
+  int slowFactor = argc > 4 ? std::stoi(argv[4]) : 8;
+  int stepUs = argc > 5 ? std::stoi(argv[5]) : 20;
+  int forwardUs = argc > 6 ? std::stoi(argv[6]) : 300;
+  int episodeLen = argc > 7 ? std::stoi(argv[7]) : 80;
+  int durationSec = argc > 8 ? std::stoi(argv[8]) : 5;
+  torch::set_num_threads(1);
+  int numEnv = numThread * numEnvPerThread;
+
+  std::cout << std::setw(10) << "mode" << std::setw(12) << "games/s" << std::setw(14)
+            << "p50_ep_ms" << std::setw(14) << "p99_ep_ms" << std::setw(12) << "steals"
+            << std::endl;
+  for (bool stealing : {false, true}) {
+    Batcher batcher(numEnv);
+    std::thread runner([&]() {
+      while (!batcher.terminated()) {
+        int64_t gen = -1;
+        auto batch = batcher.get(&gen);
+        if (batch.empty()) {
+          break;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(forwardUs));
+        TensorDict reply;
+        reply["a"] = batch.at("s").sum(1);
+        batcher.set(std::move(reply), gen);
+      }
+    });
+
+    std::vector<std::shared_ptr<SyntheticEnvs>> envs;
+    std::vector<std::shared_ptr<WorkStealingExecutor>> executors;
+    std::vector<std::shared_ptr<WorkStealingLoop>> loops;
+    if (stealing) {
+      envs.push_back(std::make_shared<SyntheticEnvs>(
+          batcher, 0, numEnv, numSlowEnv, slowFactor, stepUs, episodeLen));
+      executors.push_back(std::make_shared<WorkStealingExecutor>(envs[0], numThread));
+      for (int i = 0; i < numThread; ++i) {
+        loops.push_back(std::make_shared<WorkStealingLoop>(executors[0], i));
+      }
+    } else {
+      for (int i = 0; i < numThread; ++i) {
+        int begin = i * numEnvPerThread;
+        envs.push_back(std::make_shared<SyntheticEnvs>(
+            batcher, begin, begin + numEnvPerThread, numSlowEnv, slowFactor, stepUs,
+            episodeLen));
+        executors.push_back(std::make_shared<WorkStealingExecutor>(envs.back(), 1));
+        loops.push_back(std::make_shared<WorkStealingLoop>(executors.back(), 0));
+      }
+    }
+
+    std::vector<std::thread> threads;
+    for (auto& loop : loops) {
+      threads.emplace_back([loop]() { loop->mainLoop(); });
+    }
+    std::this_thread::sleep_for(std::chrono::seconds(durationSec));
+    for (auto& loop : loops) {
+      loop->terminate();
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    batcher.exit();
+    runner.join();
+
+    std::vector<double> episodeUs;
+    for (auto& e : envs) {
+      e->collect(episodeUs);
+    }
+    std::sort(episodeUs.begin(), episodeUs.end());
+    int64_t numSteal = 0;
+    for (auto& e : executors) {
+      numSteal += e->numSteal();
+    }
+    auto quantile = [&](double q) {
+      return episodeUs.empty() ? 0 : episodeUs[(size_t)(q * (episodeUs.size() - 1))];
+    };
+    std::cout << std::setw(10) << (stealing ? "stealing" : "static") << std::fixed
+              << std::setprecision(1) << std::setw(12)
+              << episodeUs.size() / (double)durationSec << std::setw(14)
+              << quantile(0.5) * 1e-3 << std::setw(14) << quantile(0.99) * 1e-3
+              << std::setw(12) << numSteal << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,245 @@
+// Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved
+
+#include "rela/cold_storage.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "rela/logging.h"
+#include "rela/snapshot.h"
+
+using namespace rela;
+
+// fn(s, d) for every tensor s of src and the tensor d of dst with the same key
+template <typename Fn>
+static void zipTensors(const RNNTransition& src, RNNTransition& dst, Fn fn) {
+  auto zip = [&](const TensorDict& s, TensorDict& d) {
+    for (const auto& kv : s) {
+      fn(kv.second, d.at(kv.first));
+    }
+  };
+  zip(src.obs, dst.obs);
+  zip(src.h0, dst.h0);
+  zip(src.action, dst.action);
+  fn(src.reward, dst.reward);
+  fn(src.bootstrap, dst.bootstrap);
+  fn(src.seqLen, dst.seqLen);
+}
+
+// written chunks are only read back much later, if ever: keep them out of
+// the page cache instead of pushing out the memory of the process
+static void dropPageCache(const std::string& path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd >= 0) {
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+  }
+}
+
+// v if it is positive, checked before the sizes derived from it
+static int checkPositive(int v, const std::string& name) {
+  if (v <= 0) {
+    throw std::runtime_error("cold storage " + name + " must be positive");
+  }
+  return v;
+}
+
+ColdStorage::ColdStorage(
+    const std::string& dir, int capacity, int chunkSize, int cacheSize, int seed)
+    : dir_(dir)
+    , chunkSize_(checkPositive(chunkSize, "chunk size"))
+    , numChunk_(std::max(1, checkPositive(capacity, "capacity") / chunkSize_))
+    , numRegion_(std::max(
+          1, (checkPositive(cacheSize, "cache size") + chunkSize_ - 1) / chunkSize_)) {
+  rng_.seed(seed);
+  writeThread_ = std::thread(&ColdStorage::writeLoop, this);
+  loadThread_ = std::thread(&ColdStorage::loadLoop, this);
+}
+
+ColdStorage::~ColdStorage() {
+  terminate();
+  writeThread_.join();
+  loadThread_.join();
+  for (int i = 0; i < numChunk_; ++i) {
+    unlink(chunkPath(i).c_str());
+  }
+}
+
+std::string ColdStorage::chunkPath(int64_t id) const {
+  return dir_ + "/chunk" + std::to_string(id % numChunk_);
+}
+
+void ColdStorage::append(const RNNTransition& elem) {
+  std::lock_guard<std::mutex> lk(m_);
+  if (staging_ == nullptr) {
+    staging_ = std::make_unique<RNNTransition>(elem, chunkSize_);
+  }
+  if (cache_ == nullptr) {
+    cache_ = std::make_unique<RNNTransition>(elem, numRegion_ * chunkSize_);
+  }
+  staging_->paste_(elem, numStaged_);
+  ++numStaged_;
+  if (numStaged_ < chunkSize_) {
+    return;
+  }
+
+  numStaged_ = 0;
+  if ((int)pending_.size() >= kMaxPending) {
+    // the staging chunk is reused
+    ++numDropped_;
+    RELA_WARN("cold storage: writer is behind, dropped " << numDropped_ << " chunks");
+    return;
+  }
+  pending_.push_back(std::move(*staging_));
+  staging_.reset();
+  cvWrite_.notify_one();
+}
+
+int ColdStorage::size() const {
+  std::lock_guard<std::mutex> lk(m_);
+  return (int)std::min<int64_t>(numWritten_, numChunk_) * chunkSize_;
+}
+
+int ColdStorage::numCached() const {
+  std::lock_guard<std::mutex> lk(m_);
+  return numFilled_ * chunkSize_;
+}
+
+void ColdStorage::sampleSeqFirst(int n, std::mt19937& rng, RNNTransition& dst, int begin) {
+  std::lock_guard<std::mutex> lk(m_);
+  assert(numFilled_ > 0);
+  std::uniform_int_distribution<int64_t> dist(0, numFilled_ * chunkSize_ - 1);
+  auto ids = torch::empty({n}, torch::kInt64);
+  auto idsAcc = ids.accessor<int64_t, 1>();
+  for (int i = 0; i < n; ++i) {
+    idsAcc[i] = dist(rng);
+  }
+  cache_->gatherSeqFirst(ids, dst, begin);
+  numSampled_ += n;
+  cvLoad_.notify_one();
+}
+
+void ColdStorage::flush() {
+  std::unique_lock<std::mutex> lk(m_);
+  cvWritten_.wait(lk, [this] { return terminated_ || (pending_.empty() && !writing_); });
+}
+
+void ColdStorage::terminate() {
+  {
+    std::lock_guard<std::mutex> lk(m_);
+    terminated_ = true;
+  }
+  cvWrite_.notify_all();
+  cvWritten_.notify_all();
+  cvLoad_.notify_all();
+}
+
+int64_t ColdStorage::bytesWritten() const {
+  std::lock_guard<std::mutex> lk(m_);
+  return bytesWritten_;
+}
+
+int64_t ColdStorage::bytesRead() const {
+  std::lock_guard<std::mutex> lk(m_);
+  return bytesRead_;
+}
+
+int ColdStorage::numDropped() const {
+  std::lock_guard<std::mutex> lk(m_);
+  return numDropped_;
+}
+
+void ColdStorage::writeLoop() {
+  std::unique_lock<std::mutex> lk(m_);
+  while (true) {
+    cvWrite_.wait(lk, [this] { return terminated_ || !pending_.empty(); });
+    if (terminated_) {
+      return;
+    }
+    auto chunk = std::move(pending_.front());
+    pending_.pop_front();
+    int64_t id = numWritten_;
+    writing_ = true;
+    lk.unlock();
+
+    // the file is replaced by a rename, a loader that opened the previous
+    // chunk with this path keeps reading that one
+    auto path = chunkPath(id);
+    int64_t bytes = 0;
+    bool ok = true;
+    try {
+      SnapshotWriter writer(path);
+      writer.writeTransition(chunk);
+      writer.close();
+      dropPageCache(path);
+      zipTensors(chunk, chunk, [&](const torch::Tensor& t, torch::Tensor&) {
+        bytes += t.nbytes();
+      });
+    } catch (const std::exception& e) {
+      RELA_ERROR("cold storage: " << e.what() << ", chunk dropped");
+      ok = false;
+    }
+
+    lk.lock();
+    writing_ = false;
+    if (ok) {
+      numWritten_ = id + 1;
+      bytesWritten_ += bytes;
+    } else {
+      ++numDropped_;
+    }
+    cvWritten_.notify_all();
+    cvLoad_.notify_one();
+  }
+}
+
+void ColdStorage::loadLoop() {
+  std::unique_lock<std::mutex> lk(m_);
+  while (true) {
+    cvLoad_.wait(lk, [this] {
+      return terminated_
+          || (numWritten_ > 0 && cache_ != nullptr
+              && (numFilled_ < numRegion_ || numSampled_ >= chunkSize_));
+    });
+    if (terminated_) {
+      return;
+    }
+    int64_t first = std::max<int64_t>(0, numWritten_ - numChunk_);
+    std::uniform_int_distribution<int64_t> dist(first, numWritten_ - 1);
+    auto path = chunkPath(dist(rng_));
+    lk.unlock();
+
+    // read the whole chunk outside of the lock, sampling only waits for the
+    // copy into the cache
+    RNNTransition chunk;
+    int64_t bytes = 0;
+    try {
+      SnapshotReader reader(path);
+      chunk = reader.readTransition();
+      zipTensors(chunk, chunk, [&](const torch::Tensor& t, torch::Tensor& loaded) {
+        loaded = t.clone();
+        bytes += t.nbytes();
+      });
+    } catch (const std::exception& e) {
+      RELA_ERROR("cold storage: " << e.what());
+      lk.lock();
+      continue;
+    }
+
+    lk.lock();
+    int region = numFilled_ < numRegion_ ? numFilled_ : nextRegion_;
+    zipTensors(chunk, *cache_, [&](const torch::Tensor& t, torch::Tensor& cached) {
+      cached.narrow(0, region * chunkSize_, chunkSize_).copy_(t);
+    });
+    if (numFilled_ < numRegion_) {
+      ++numFilled_;
+    } else {
+      nextRegion_ = (nextRegion_ + 1) % numRegion_;
+      numSampled_ -= chunkSize_;
+    }
+    bytesRead_ += bytes;
+  }
+}
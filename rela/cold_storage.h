@@ -0,0 +1,106 @@
+// Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+
+#include "rela/transition.h"
+
+namespace rela {
+
+// Disk tier of a replay buffer. Appended elements are batched into chunks
+// of chunkSize that a writer thread streams to a ring of chunk files in dir,
+// at most capacity elements are kept. A loader thread keeps a cache of
+// cacheSize elements (rounded up to whole chunks) filled from random chunks
+// and replaces one chunk of it every chunkSize sampled elements, so cached
+// elements are sampled about once. Sampling only reads the cache and never
+// waits for the disk.
+//
+// Elements are stored as given, e.g. encoded by the replay codec, and must
+// all have the same shapes. The chunk files are removed on destruction.
+class ColdStorage {
+ public:
+  ColdStorage(
+      const std::string& dir, int capacity, int chunkSize, int cacheSize, int seed);
+
+  ColdStorage(const ColdStorage&) = delete;
+  ColdStorage& operator=(const ColdStorage&) = delete;
+
+  ~ColdStorage();
+
+  // copies elem, full chunks are dropped with a warning if the writer falls
+  // kMaxPending chunks behind
+  void append(const RNNTransition& elem);
+
+  // elements on disk
+  int size() const;
+
+  // elements in the cache, 0 until the first chunk is loaded
+  int numCached() const;
+
+  // n cached elements drawn uniformly into elements [begin, begin + n) of
+  // a seq first batch, see RNNTransition::allocateSeqFirst
+  void sampleSeqFirst(int n, std::mt19937& rng, RNNTransition& dst, int begin);
+
+  // block until every full chunk appended so far is on disk
+  void flush();
+
+  void terminate();
+
+  int64_t bytesWritten() const;
+
+  int64_t bytesRead() const;
+
+  int numDropped() const;
+
+ private:
+  static constexpr int kMaxPending = 4;
+
+  std::string chunkPath(int64_t id) const;
+
+  void writeLoop();
+
+  void loadLoop();
+
+  const std::string dir_;
+  const int chunkSize_;
+  const int numChunk_;
+  const int numRegion_;
+
+  mutable std::mutex m_;
+  std::condition_variable cvWrite_;
+  std::condition_variable cvWritten_;
+  std::condition_variable cvLoad_;
+
+  // chunk being filled and full chunks waiting for the writer
+  std::unique_ptr<RNNTransition> staging_;
+  int numStaged_ = 0;
+  std::deque<RNNTransition> pending_;
+  bool writing_ = false;
+  // chunk ids are consecutive, the last numChunk_ written ones are on disk
+  int64_t numWritten_ = 0;
+
+  // [numRegion_ * chunkSize_, ...], region r holds a copy of one chunk
+  std::unique_ptr<RNNTransition> cache_;
+  int numFilled_ = 0;
+  int nextRegion_ = 0;
+  // elements sampled since the last region was replaced
+  int numSampled_ = 0;
+
+  int64_t bytesWritten_ = 0;
+  int64_t bytesRead_ = 0;
+  int numDropped_ = 0;
+  bool terminated_ = false;
+
+  std::mt19937 rng_;
+  std::thread writeThread_;
+  std::thread loadThread_;
+};
+
+}  // namespace rela
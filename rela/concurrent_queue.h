@@ -1,8 +1,17 @@
 #pragma once
 
+#include <cstring>
+#include <random>
+#include <stdexcept>
 #include <vector>
 
+#include "rela/logging.h"
+#include "rela/ragged_storage.h"
+#include "rela/snapshot.h"
+#include "rela/storage_codec.h"
+#include "rela/sum_tree.h"
 #include "rela/tensor_dict.h"
+#include "rela/thread_pool.h"
 #include "rela/transition.h"
 
 namespace rela {
@@ -10,23 +19,32 @@ namespace rela {
 // template <class DataType>
 class ConcurrentQueue {
  public:
-  ConcurrentQueue(int capacity)
+  // seqFirst: store elements as [T, capacity, ...], see RNNTransition.
+  // numStep > 0: store only the seqLen valid steps of each element in an
+  // arena of numStep steps, see RaggedStorage
+  ConcurrentQueue(int capacity, bool seqFirst = false, int numStep = 0)
       : capacity(capacity)
+      , seqFirst_(seqFirst)
+      , numStep_(numStep)
       , head_(0)
       , tail_(0)
       , size_(0)
       , safeTail_(0)
       , safeSize_(0)
-      , sum_(0)
-      , evicted_(capacity, false)
+      , evicted_(capacity, true)
+      , appendId_(capacity, 0)
+      , stepOffset_(numStep > 0 ? capacity : 0)
+      , stepLen_(numStep > 0 ? capacity : 0)
       // , elements_(capacity)
-      , weights_(capacity, 0) {
+      , weights_(capacity, 0)
+      , tree_(capacity) {
+    assert(!(seqFirst && numStep > 0));
   }
 
   int safeSize(float* sum) const {
     std::unique_lock<std::mutex> lk(m_);
     if (sum != nullptr) {
-      *sum = sum_;
+      *sum = tree_.sum();
     }
     return safeSize_;
   }
@@ -36,6 +54,46 @@ class ConcurrentQueue {
     return size_;
   }
 
+  // valid steps of all elements, including unsafe ones
+  int numStepUsed() const {
+    std::unique_lock<std::mutex> lk(m_);
+    return stepUsed_;
+  }
+
+  // number of elements to pop from the head so that at most maxSize elements
+  // and maxStep steps (if > 0) remain and the largest block appended so far
+  // fits in the arena again, limited to the safe elements. 0 while a
+  // snapshot is being written, the queue then grows into its slack
+  int numOverflow(int maxSize, int maxStep) const {
+    std::unique_lock<std::mutex> lk(m_);
+    if (numSaving_ > 0) {
+      return 0;
+    }
+    int n = std::max(0, size_ - maxSize);
+    if (maxStep > 0 && numStep_ > 0) {
+      int used = stepUsed_;
+      for (int i = 0; i < n; ++i) {
+        used -= stepLen_[(head_ + i) % capacity];
+      }
+      while (used > maxStep && n < safeSize_) {
+        used -= stepLen_[(head_ + n) % capacity];
+        ++n;
+      }
+    }
+    if (numStep_ > 0) {
+      // with a small slack maxStep alone can leave the arena too fragmented
+      // for the next block, which would then wait forever
+      while (n < safeSize_) {
+        int stepHead = stepOffset_[(head_ + n) % capacity];
+        if (findSteps(maxBlockStep_, stepHead, stepTail_, size_ - n) >= 0) {
+          break;
+        }
+        ++n;
+      }
+    }
+    return std::min(n, safeSize_);
+  }
+
   void clear() {
     std::unique_lock<std::mutex> lk(m_);
     head_ = 0;
@@ -43,9 +101,12 @@ class ConcurrentQueue {
     size_ = 0;
     safeTail_ = 0;
     safeSize_ = 0;
-    sum_ = 0;
-    std::fill(evicted_.begin(), evicted_.end(), false);
+    stepHead_ = 0;
+    stepTail_ = 0;
+    stepUsed_ = 0;
+    std::fill(evicted_.begin(), evicted_.end(), true);
     std::fill(weights_.begin(), weights_.end(), 0.0);
+    tree_.clear();
   }
 
   void terminate() {
@@ -54,19 +115,59 @@ class ConcurrentQueue {
   }
 
   void append(const RNNTransition& data, float weight) {
-    int blockSize = 1;
+    appendBlock(data.asBlock(), 1, weight);
+  }
+
+  // append elements [0, blockSize) of block, a batch major storage (see
+  // RNNTransition(const RNNTransition&, int)), as one reservation and one
+  // copy per key into contiguous slots. blocks while they do not fit
+  void appendBlock(const RNNTransition& block, int blockSize, float weight) {
+    assert(blockSize > 0 && blockSize <= capacity);
+    std::vector<int> lens(numStep_ > 0 ? blockSize : 0);
+    int blockStep = 0;
+    if (numStep_ > 0) {
+      auto seqLen = block.seqLen.narrow(0, 0, blockSize).to(torch::kInt32);
+      auto seqLenAcc = seqLen.accessor<int, 1>();
+      for (int i = 0; i < blockSize; ++i) {
+        lens[i] = seqLenAcc[i];
+        blockStep += lens[i];
+      }
+      if (blockStep > numStep_) {
+        throw std::runtime_error(
+            "block of " + std::to_string(blockStep) + " steps does not fit in a step arena of "
+            + std::to_string(numStep_));
+      }
+    }
+    std::vector<int> offsets;
     std::unique_lock<std::mutex> lk(m_);
-    cvSize_.wait(lk, [=] { return terminated_ || (size_ + blockSize <= capacity); });
+    maxBlockStep_ = std::max(maxBlockStep_, blockStep);
+    cvSize_.wait(lk, [&] {
+      return terminated_ || (size_ + blockSize <= capacity && findSteps(lens, &offsets));
+    });
     if (terminated_) {
       return;
     }
 
-    if (elements_ == nullptr) {
-      elements_ = std::make_unique<RNNTransition>(data, capacity);
+    if (!allocated()) {
+      allocate(block.index(0));
     }
 
     int start = tail_;
     int end = (tail_ + blockSize) % capacity;
+    for (int i = 0; i < blockSize; ++i) {
+      int id = (start + i) % capacity;
+      evicted_[id] = false;
+      appendId_[id] = numAppend_++;
+      if (numStep_ > 0) {
+        if (size_ == 0 && i == 0) {
+          stepHead_ = offsets[i];
+        }
+        stepOffset_[id] = offsets[i];
+        stepLen_[id] = lens[i];
+        stepTail_ = offsets[i] + lens[i];
+        stepUsed_ += lens[i];
+      }
+    }
 
     tail_ = end;
     size_ += blockSize;
@@ -74,77 +175,371 @@ class ConcurrentQueue {
 
     lk.unlock();
 
-    elements_->paste_(data, start);
-    weights_[start] = weight;
+    auto encoded = encode(block);
+    if (numStep_ > 0) {
+      for (int i = 0; i < blockSize; ++i) {
+        ragged_->paste_(encoded.index(i), (start + i) % capacity, offsets[i], lens[i]);
+      }
+    } else {
+      // at most two runs of slots, the second one wrapped around to 0
+      int first = std::min(blockSize, capacity - start);
+      elements_->pasteBlock_(encoded, 0, start, first);
+      if (first < blockSize) {
+        elements_->pasteBlock_(encoded, first, 0, blockSize - first);
+      }
+    }
+    for (int i = 0; i < blockSize; ++i) {
+      weights_[(start + i) % capacity] = weight;
+    }
 
     lk.lock();
 
     cvTail_.wait(lk, [=] { return safeTail_ == start; });
     safeTail_ = end;
     safeSize_ += blockSize;
-    sum_ += weight;
+    // only safe elements carry weight in the tree
+    for (int i = 0; i < blockSize; ++i) {
+      tree_.set((start + i) % capacity, weight);
+    }
     checkSize(head_, safeTail_, safeSize_);
 
     lk.unlock();
     cvTail_.notify_all();
   }
 
+  // compress obs key in storage, see StorageCodec. must be set before the
+  // first append
+  void setObsCodec(const std::string& key, const std::string& kind, int size) {
+    std::lock_guard<std::mutex> lk(m_);
+    assert(!allocated());
+    codec_.set(key, kind, size);
+  }
+
+  // storage bytes per element, and the same before encoding. 0 until the
+  // first append
+  int64_t bytesPerElement() const {
+    std::lock_guard<std::mutex> lk(m_);
+    return bytesPerElement_;
+  }
+
+  int64_t rawBytesPerElement() const {
+    std::lock_guard<std::mutex> lk(m_);
+    return rawBytesPerElement_;
+  }
+
+  // write the safe elements, their weights and the storage to a snapshot
+  // file. only the metadata is copied with the queue locked, the storage is
+  // streamed to the file afterwards while pops wait: the safe elements are
+  // then immutable, appends only write slots and steps outside of them
+  void saveSnapshot(const std::string& path) const {
+    SnapshotWriter writer(path);
+    {
+      std::lock_guard<std::mutex> lk(m_);
+      writer.writeInt(capacity);
+      writer.writeInt(seqFirst_);
+      writer.writeInt(numStep_);
+      writer.writeInt(head_);
+      writer.writeInt(safeTail_);
+      writer.writeInt(safeSize_);
+      // the arena of the safe elements, excluding reservations in flight
+      int stepHead = 0;
+      int stepTail = 0;
+      int stepUsed = 0;
+      if (numStep_ > 0 && safeSize_ > 0) {
+        int last = (safeTail_ - 1 + capacity) % capacity;
+        stepHead = stepHead_;
+        stepTail = stepOffset_[last] + stepLen_[last];
+        for (int i = 0; i < safeSize_; ++i) {
+          stepUsed += stepLen_[(head_ + i) % capacity];
+        }
+      }
+      writer.writeInt(stepHead);
+      writer.writeInt(stepTail);
+      writer.writeInt(stepUsed);
+      writer.writeInt(bytesPerElement_);
+      writer.writeInt(rawBytesPerElement_);
+      writer.writeInt(allocated());
+      if (allocated()) {
+        codec_.save(writer);
+        writer.writeTensor(torch::from_blob(
+            const_cast<float*>(weights_.data()), {capacity}, torch::kFloat32).clone());
+        auto evicted = torch::empty({capacity}, torch::kUInt8);
+        auto evictedAcc = evicted.accessor<uint8_t, 1>();
+        for (int i = 0; i < capacity; ++i) {
+          evictedAcc[i] = evicted_[i];
+        }
+        writer.writeTensor(evicted);
+        if (numStep_ > 0) {
+          writer.writeTensor(torch::from_blob(
+              const_cast<int*>(stepOffset_.data()), {capacity}, torch::kInt32).clone());
+          writer.writeTensor(torch::from_blob(
+              const_cast<int*>(stepLen_.data()), {capacity}, torch::kInt32).clone());
+          writer.writeInt(ragged_->maxSeqLen());
+          writer.writeTransition(ragged_->data());
+        } else {
+          writer.writeTransition(*elements_);
+        }
+      }
+      ++numSaving_;
+    }
+
+    auto done = [this] {
+      {
+        std::lock_guard<std::mutex> lk(m_);
+        --numSaving_;
+      }
+      cvSize_.notify_all();
+    };
+    try {
+      writer.close();
+    } catch (...) {
+      done();
+      throw;
+    }
+    done();
+  }
+
+  // restore a snapshot into this queue, which must be empty and constructed
+  // with the same arguments. the storage tensors map the file, pages are
+  // read on first access and copied on first write
+  void loadSnapshot(const std::string& path) {
+    std::lock_guard<std::mutex> lk(m_);
+    if (allocated() || size_ != 0 || numSaving_ > 0) {
+      throw std::runtime_error("snapshot can only be loaded into an empty queue");
+    }
+    SnapshotReader reader(path);
+    int snapCapacity = reader.readInt();
+    bool snapSeqFirst = reader.readInt();
+    int snapNumStep = reader.readInt();
+    if (snapCapacity != capacity || snapSeqFirst != seqFirst_ || snapNumStep != numStep_) {
+      throw std::runtime_error(
+          "snapshot " + path + " has capacity " + std::to_string(snapCapacity)
+          + ", numStep " + std::to_string(snapNumStep) + ", seqFirst "
+          + std::to_string(snapSeqFirst) + ", not the ones of this queue");
+    }
+    head_ = reader.readInt();
+    tail_ = safeTail_ = reader.readInt();
+    size_ = safeSize_ = reader.readInt();
+    stepHead_ = reader.readInt();
+    stepTail_ = reader.readInt();
+    stepUsed_ = reader.readInt();
+    bytesPerElement_ = reader.readInt();
+    rawBytesPerElement_ = reader.readInt();
+    if (!reader.readInt()) {
+      return;
+    }
+
+    codec_.load(reader);
+    auto weights = reader.readTensor();
+    std::memcpy(weights_.data(), weights.data_ptr(), weights.nbytes());
+    auto evicted = reader.readTensor();
+    auto evictedAcc = evicted.accessor<uint8_t, 1>();
+    for (int i = 0; i < capacity; ++i) {
+      evicted_[i] = evictedAcc[i];
+    }
+    // pending updates of samples taken before the snapshot are not kept
+    for (int i = 0; i < safeSize_; ++i) {
+      appendId_[(head_ + i) % capacity] = i;
+    }
+    numAppend_ = safeSize_;
+    if (numStep_ > 0) {
+      auto offsets = reader.readTensor();
+      auto lens = reader.readTensor();
+      std::memcpy(stepOffset_.data(), offsets.data_ptr(), offsets.nbytes());
+      std::memcpy(stepLen_.data(), lens.data_ptr(), lens.nbytes());
+      int maxSeqLen = reader.readInt();
+      ragged_ = std::make_unique<RaggedStorage>(reader.readTransition(), maxSeqLen);
+    } else {
+      elements_ = std::make_unique<RNNTransition>(reader.readTransition());
+      elements_->seqFirstStorage = seqFirst_;
+    }
+
+    tree_.clear();
+    for (int i = 0; i < safeSize_; ++i) {
+      int id = (head_ + i) % capacity;
+      tree_.set(id, weights_[id]);
+    }
+  }
+
   // ------------------------------------------------------------- //
   // blockPop, update are thread-safe against blockAppend
   // but they are NOT thread-safe against each other
   void blockPop(int blockSize) {
-    double diff = 0;
-    int head = head_;
-    for (int i = 0; i < blockSize; ++i) {
-      diff -= weights_[head];
-      evicted_[head] = true;
-      head = (head + 1) % capacity;
-    }
-
     {
-      std::lock_guard<std::mutex> lk(m_);
-      sum_ += diff;
+      std::unique_lock<std::mutex> lk(m_);
+      // popped slots may be overwritten, not while a snapshot reads them
+      cvSize_.wait(lk, [this] { return numSaving_ == 0; });
+      int head = head_;
+      for (int i = 0; i < blockSize; ++i) {
+        evicted_[head] = true;
+        tree_.set(head, 0);
+        if (numStep_ > 0) {
+          stepUsed_ -= stepLen_[head];
+        }
+        head = (head + 1) % capacity;
+      }
       head_ = head;
       safeSize_ -= blockSize;
       size_ -= blockSize;
+      if (numStep_ > 0) {
+        // the arena is freed up to the new head, or entirely
+        if (size_ > 0) {
+          stepHead_ = stepOffset_[head_];
+        } else {
+          stepHead_ = 0;
+          stepTail_ = 0;
+        }
+      }
       assert(safeSize_ >= 0);
       checkSize(head_, safeTail_, safeSize_);
     }
     cvSize_.notify_all();
   }
 
-  void update(const std::vector<int>& ids, const torch::Tensor& weights) {
-    double diff = 0;
+  // set the weights of sampled ids, skipping those popped or replaced by a
+  // later append since they were sampled, see sampleIdx
+  void update(
+      const std::vector<int>& ids,
+      const std::vector<int64_t>& appendIds,
+      const torch::Tensor& weights) {
+    assert(ids.size() == appendIds.size());
     auto weightAcc = weights.accessor<float, 1>();
+    std::lock_guard<std::mutex> lk_(m_);
     for (int i = 0; i < (int)ids.size(); ++i) {
       auto id = ids[i];
-      if (evicted_[id]) {
+      if (evicted_[id] || appendId_[id] != appendIds[i]) {
         continue;
       }
-      diff += (weightAcc[i] - weights_[id]);
       weights_[id] = weightAcc[i];
+      tree_.set(id, weightAcc[i]);
     }
+  }
 
-    std::lock_guard<std::mutex> lk_(m_);
-    sum_ += diff;
+  // stratified sampling proportional to weight over [0, safeSize): one
+  // element per 1/batchsize of the total weight, O(log capacity) each.
+  // fills the logical indices, ids (for update()) and weights of the
+  // samples and returns the total weight. appendIds identify the sampled
+  // elements for update() after their ids have been reused
+  float sampleIdx(
+      int batchsize,
+      std::mt19937& rng,
+      std::vector<int>* indices,
+      std::vector<int>* ids,
+      std::vector<int64_t>* appendIds,
+      std::vector<float>* weights) const {
+    std::lock_guard<std::mutex> lk(m_);
+    double sum = tree_.sum();
+    assert(safeSize_ > 0 && sum > 0);
+    double segment = sum / batchsize;
+    std::uniform_real_distribution<double> dist(0.0, segment);
+
+    indices->resize(batchsize);
+    ids->resize(batchsize);
+    appendIds->resize(batchsize);
+    weights->resize(batchsize);
+    for (int i = 0; i < batchsize; ++i) {
+      int id = tree_.find(dist(rng) + i * segment);
+      (*ids)[i] = id;
+      (*appendIds)[i] = appendId_[id];
+      (*indices)[i] = (id - head_ + capacity) % capacity;
+      (*weights)[i] = (float)tree_.get(id);
+    }
+    return (float)sum;
   }
 
   // ------------------------------------------------------------- //
   // accessing elements is never locked, operate safely!
   RNNTransition get(int idx) const {
     int id = (head_ + idx) % capacity;
-    return elements_->index(id);
+    return decode(element(id));
+  }
+
+  // element as stored, i.e. with the obs still encoded
+  RNNTransition getEncoded(int idx) const {
+    return element((head_ + idx) % capacity);
   }
 
   void copyTo(int idx, RNNTransition& dst, int dstSlot) {
-    int id = (head_ + idx) % capacity;
-    elements_->copyTo(id, dst, dstSlot);
+    dst.paste_(get(idx), dstSlot);
   }
 
-  RNNTransition getElementAndMark(int idx) {
-    int id = (head_ + idx) % capacity;
-    evicted_[id] = false;
-    return elements_->index(id);
+  // batch of elements indices in the seq first layout on device, gathered
+  // in parallel chunks on pool (may be nullptr). no transpose is needed when
+  // the storage itself is seq first. encoded obs are decoded after the copy
+  // to device, so only the compact bytes are transferred
+  RNNTransition gatherSeqFirst(
+      const std::vector<int>& indices, const std::string& device, ThreadPool* pool) const {
+    // pinned so that the copy to device does not go through a staging buffer
+    auto batch = allocateSeqFirst((int)indices.size(), device != "cpu");
+    gatherSeqFirst(indices, batch, 0, pool);
+    batch.to_(device);
+    return decode(batch);
+  }
+
+  // the steps of gatherSeqFirst, for batches of several queues with the
+  // same elements: uninitialized encoded batch, filled at [begin, begin +
+  // indices.size()) by each queue, then moved and decoded
+  RNNTransition allocateSeqFirst(int bsz, bool pinned) const {
+    assert(allocated());
+    if (numStep_ > 0) {
+      return ragged_->allocateSeqFirst(bsz, pinned);
+    }
+    return elements_->allocateSeqFirst(bsz, pinned);
+  }
+
+  void gatherSeqFirst(
+      const std::vector<int>& indices, RNNTransition& dst, int begin, ThreadPool* pool)
+      const {
+    int bsz = (int)indices.size();
+    auto ids = torch::empty({bsz}, torch::kInt64);
+    auto idsAcc = ids.accessor<int64_t, 1>();
+    for (int i = 0; i < bsz; ++i) {
+      idsAcc[i] = (head_ + indices[i]) % capacity;
+    }
+
+    torch::Tensor offsets;
+    torch::Tensor lens;
+    if (numStep_ > 0) {
+      offsets = torch::empty({bsz}, torch::kInt64);
+      lens = torch::empty({bsz}, torch::kInt64);
+      auto offsetAcc = offsets.accessor<int64_t, 1>();
+      auto lenAcc = lens.accessor<int64_t, 1>();
+      for (int i = 0; i < bsz; ++i) {
+        offsetAcc[i] = stepOffset_[idsAcc[i]];
+        lenAcc[i] = stepLen_[idsAcc[i]];
+      }
+    }
+
+    int numChunk = pool == nullptr ? 1 : std::min(bsz, pool->numThread() + 1);
+    auto gather = [&](int chunk) {
+      int chunkBegin = (int64_t)bsz * chunk / numChunk;
+      int chunkEnd = (int64_t)bsz * (chunk + 1) / numChunk;
+      if (chunkBegin == chunkEnd) {
+        return;
+      }
+      if (numStep_ > 0) {
+        ragged_->gatherSeqFirst(
+            ids.slice(0, chunkBegin, chunkEnd),
+            offsets.slice(0, chunkBegin, chunkEnd),
+            lens.slice(0, chunkBegin, chunkEnd),
+            dst,
+            begin + chunkBegin);
+      } else {
+        elements_->gatherSeqFirst(ids.slice(0, chunkBegin, chunkEnd), dst, begin + chunkBegin);
+      }
+    };
+    if (pool == nullptr) {
+      gather(0);
+    } else {
+      pool->parallelFor(numChunk, gather);
+    }
+  }
+
+  RNNTransition decode(RNNTransition data) const {
+    if (!codec_.empty()) {
+      data.obs = codec_.decode(data.obs);
+    }
+    return data;
   }
 
   float getWeight(int idx, int* id) {
@@ -156,6 +551,100 @@ class ConcurrentQueue {
   const int capacity;
 
  private:
+  bool allocated() const {
+    return elements_ != nullptr || ragged_ != nullptr;
+  }
+
+  // called with m_ held on the first append
+  void allocate(const RNNTransition& data) {
+    codec_.init(data.obs);
+    if (numStep_ > 0) {
+      ragged_ = std::make_unique<RaggedStorage>(encode(data), capacity, numStep_);
+      bytesPerElement_ = ragged_->bytes() / capacity;
+    } else {
+      elements_ = std::make_unique<RNNTransition>(encode(data), capacity, seqFirst_);
+      bytesPerElement_ = transitionBytes(*elements_) / capacity;
+    }
+    rawBytesPerElement_ = transitionBytes(data);
+    RELA_INFO(
+        "replay storage: " << capacity << " x " << bytesPerElement_
+                           << " bytes/episode, " << rawBytesPerElement_
+                           << " bytes/episode before encoding"
+                           << (numStep_ > 0 ? " and padding" : ""));
+  }
+
+  RNNTransition element(int id) const {
+    if (numStep_ > 0) {
+      return ragged_->index(id, stepOffset_[id], stepLen_[id]);
+    }
+    return elements_->index(id);
+  }
+
+  // arena offset for len more steps after [stepHead, stepTail) holding size
+  // elements, -1 if they do not fit yet. episodes are contiguous, one that
+  // does not fit at the end starts over at 0. the range in use is wrapped
+  // around if stepTail <= stepHead while not empty
+  int findSteps(int len, int stepHead, int stepTail, int size) const {
+    assert(len > 0 && len <= numStep_);
+    if (size == 0) {
+      return 0;
+    }
+    if (stepTail > stepHead) {
+      if (stepTail + len <= numStep_) {
+        return stepTail;
+      }
+      return len <= stepHead ? 0 : -1;
+    }
+    return stepTail + len <= stepHead ? stepTail : -1;
+  }
+
+  // arena offsets for consecutive elements of lens steps, false if they do
+  // not all fit yet. with m_ held
+  bool findSteps(const std::vector<int>& lens, std::vector<int>* offsets) const {
+    if (numStep_ == 0) {
+      return true;
+    }
+    offsets->resize(lens.size());
+    int stepHead = stepHead_;
+    int stepTail = stepTail_;
+    int size = size_;
+    for (size_t i = 0; i < lens.size(); ++i) {
+      int offset = findSteps(lens[i], stepHead, stepTail, size);
+      if (offset < 0) {
+        return false;
+      }
+      if (size == 0) {
+        stepHead = offset;
+      }
+      (*offsets)[i] = offset;
+      stepTail = offset + lens[i];
+      ++size;
+    }
+    return true;
+  }
+
+  static int64_t transitionBytes(const RNNTransition& t) {
+    int64_t bytes = t.reward.nbytes() + t.bootstrap.nbytes() + t.seqLen.nbytes();
+    for (const auto* dict : {&t.obs, &t.h0, &t.action}) {
+      for (const auto& kv : *dict) {
+        bytes += kv.second.nbytes();
+      }
+    }
+    return bytes;
+  }
+
+  RNNTransition encode(const RNNTransition& data) const {
+    if (codec_.empty()) {
+      return data;
+    }
+    RNNTransition encoded = data;
+    encoded.obs = codec_.encode(data.obs);
+    return encoded;
+  }
+
+  const bool seqFirst_;
+  const int numStep_;
+
   void checkSize(int head, int tail, int size) {
     if (size == 0) {
       assert(tail == head);
@@ -174,7 +663,8 @@ class ConcurrentQueue {
   }
 
   mutable std::mutex m_;
-  std::condition_variable cvSize_;
+  // also notified when a snapshot is written
+  mutable std::condition_variable cvSize_;
   std::condition_variable cvTail_;
 
   int head_;
@@ -183,11 +673,33 @@ class ConcurrentQueue {
 
   int safeTail_;
   int safeSize_;
-  double sum_;
+  // slot popped and not appended to since, and the append that filled it
   std::vector<bool> evicted_;
+  std::vector<int64_t> appendId_;
+  int64_t numAppend_ = 0;
 
   std::unique_ptr<RNNTransition> elements_;
+  std::unique_ptr<RaggedStorage> ragged_;
+  // arena range of each element and the arena in use, if numStep_ > 0.
+  // protected by m_ except for reading the ranges of safe elements
+  std::vector<int> stepOffset_;
+  std::vector<int> stepLen_;
+  int stepHead_ = 0;
+  int stepTail_ = 0;
+  int stepUsed_ = 0;
+  // steps of the largest block appended so far, numOverflow() keeps that
+  // many contiguous steps free
+  int maxBlockStep_ = 1;
+  // fixed once elements_ is allocated
+  StorageCodec codec_;
+  int64_t bytesPerElement_ = 0;
+  int64_t rawBytesPerElement_ = 0;
   std::vector<float> weights_;
+  // weights of the safe elements by id, protected by m_
+  SumTree tree_;
+
+  // snapshots being streamed by saveSnapshot(), pops wait for them
+  mutable int numSaving_ = 0;
 
   bool terminated_ = false;
 };
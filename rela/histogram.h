@@ -0,0 +1,157 @@
+// Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace rela {
+
+// Histogram with a fixed set of buckets that can be written by many threads
+// without locking. In log scale a value v >= 1 lands in one of
+// kSubBucket buckets per power of two (relative error < 1/kSubBucket),
+// values < 1 land in bucket 0. In linear scale bucket i holds value i and
+// values >= numBucket - 1 are clamped into the last bucket.
+class Histogram {
+ public:
+  static constexpr int kSubBucket = 8;
+  static constexpr int kNumOctave = 48;
+
+  static Histogram linear(int maxValue) {
+    return Histogram(false, maxValue + 1);
+  }
+
+  static Histogram log() {
+    return Histogram(true, kNumOctave * kSubBucket + 1);
+  }
+
+  void add(double v) {
+    v = std::max(v, 0.0);
+    buckets_[bucketIdx(v)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    // no atomic add for double before c++20
+    double sum = sum_.load(std::memory_order_relaxed);
+    while (!sum_.compare_exchange_weak(sum, sum + v, std::memory_order_relaxed)) {
+    }
+    double max = max_.load(std::memory_order_relaxed);
+    while (v > max && !max_.compare_exchange_weak(max, v, std::memory_order_relaxed)) {
+    }
+  }
+
+  // not atomic w.r.t. concurrent add(), a few samples may be lost
+  void reset() {
+    for (int i = 0; i < numBucket_; ++i) {
+      buckets_[i] = 0;
+    }
+    count_ = 0;
+    sum_ = 0;
+    max_ = 0;
+  }
+
+  int64_t count() const {
+    return count_.load();
+  }
+
+  double sum() const {
+    return sum_.load();
+  }
+
+  // upper bound of the bucket holding the q-quantile, capped by max
+  double quantile(double q) const {
+    int64_t total = 0;
+    std::vector<int64_t> counts(numBucket_);
+    for (int i = 0; i < numBucket_; ++i) {
+      counts[i] = buckets_[i].load(std::memory_order_relaxed);
+      total += counts[i];
+    }
+    if (total == 0) {
+      return 0;
+    }
+
+    int64_t rank = std::max<int64_t>(1, (int64_t)std::ceil(q * total));
+    int64_t seen = 0;
+    for (int i = 0; i < numBucket_; ++i) {
+      seen += counts[i];
+      if (seen >= rank) {
+        return std::min(bucketUpper(i), max_.load());
+      }
+    }
+    return max_.load();
+  }
+
+  // count, mean, p50, p90, p99, max
+  std::unordered_map<std::string, double> summary() const {
+    std::unordered_map<std::string, double> ret;
+    int64_t count = count_.load();
+    ret["count"] = count;
+    ret["mean"] = count ? sum_.load() / count : 0;
+    ret["p50"] = quantile(0.5);
+    ret["p90"] = quantile(0.9);
+    ret["p99"] = quantile(0.99);
+    ret["max"] = max_.load();
+    return ret;
+  }
+
+  // (bucket upper bound, count) of non-empty buckets
+  std::vector<std::pair<double, int64_t>> buckets() const {
+    std::vector<std::pair<double, int64_t>> ret;
+    for (int i = 0; i < numBucket_; ++i) {
+      int64_t c = buckets_[i].load(std::memory_order_relaxed);
+      if (c > 0) {
+        ret.emplace_back(bucketUpper(i), c);
+      }
+    }
+    return ret;
+  }
+
+ private:
+  Histogram(bool logScale, int numBucket)
+      : logScale_(logScale)
+      , numBucket_(numBucket)
+      , buckets_(new std::atomic<int64_t>[numBucket]) {
+    assert(numBucket_ > 0);
+    reset();
+  }
+
+  int bucketIdx(double v) const {
+    if (!logScale_) {
+      return std::min((int)v, numBucket_ - 1);
+    }
+    if (v < 1) {
+      return 0;
+    }
+    int exp = 0;
+    // v = frac * 2^exp, frac in [0.5, 1)
+    double frac = std::frexp(v, &exp);
+    int sub = (int)((frac * 2 - 1) * kSubBucket);
+    int idx = 1 + (exp - 1) * kSubBucket + sub;
+    return std::min(idx, numBucket_ - 1);
+  }
+
+  double bucketUpper(int idx) const {
+    if (!logScale_) {
+      return idx;
+    }
+    if (idx == 0) {
+      return 1;
+    }
+    int octave = (idx - 1) / kSubBucket;
+    int sub = (idx - 1) % kSubBucket;
+    return std::ldexp(1.0 + (double)(sub + 1) / kSubBucket, octave);
+  }
+
+  const bool logScale_;
+  const int numBucket_;
+  std::unique_ptr<std::atomic<int64_t>[]> buckets_;
+  std::atomic<int64_t> count_{0};
+  std::atomic<double> sum_{0};
+  std::atomic<double> max_{0};
+};
+
+}  // namespace rela
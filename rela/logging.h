@@ -0,0 +1,90 @@
+// Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved
+
+#pragma once
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+
+// Log statements below RELA_COMPILED_LOG_LEVEL are removed at compile time,
+// the others are filtered at runtime by rela::logging::setLevel(), which
+// defaults to $RELA_LOG_LEVEL (trace/debug/info/warn/error or 0-4) or info.
+// Per step tracing uses RELA_TRACE/RELA_DEBUG, so it costs nothing unless
+// built with e.g. -DRELA_COMPILED_LOG_LEVEL=0.
+#ifndef RELA_COMPILED_LOG_LEVEL
+#define RELA_COMPILED_LOG_LEVEL 2
+#endif
+
+namespace rela {
+
+enum LogLevel : int {
+  kTrace = 0,
+  kDebug = 1,
+  kInfo = 2,
+  kWarn = 3,
+  kError = 4,
+};
+
+namespace logging {
+
+inline int parseLevel(const char* s, int fallback) {
+  if (s == nullptr || *s == '\0') {
+    return fallback;
+  }
+  const char* names[] = {"trace", "debug", "info", "warn", "error"};
+  for (int i = 0; i < 5; ++i) {
+    if (strcmp(s, names[i]) == 0) {
+      return i;
+    }
+  }
+  return atoi(s);
+}
+
+// one instance per shared library, i.e. rela and hanalearn each have one
+inline std::atomic<int>& level() {
+  static std::atomic<int> level{parseLevel(std::getenv("RELA_LOG_LEVEL"), kInfo)};
+  return level;
+}
+
+inline void setLevel(int l) {
+  level() = l;
+}
+
+inline int getLevel() {
+  return level().load(std::memory_order_relaxed);
+}
+
+inline bool enabled(int l) {
+  return l >= getLevel();
+}
+
+// a single write per line so that lines of different threads do not mix
+inline void write(std::string line) {
+  line.push_back('\n');
+  fwrite(line.data(), 1, line.size(), stdout);
+  fflush(stdout);
+}
+
+}  // namespace logging
+}  // namespace rela
+
+#define RELA_LOG_ON(level) \
+  ((level) >= RELA_COMPILED_LOG_LEVEL && ::rela::logging::enabled(level))
+
+#define RELA_LOG(level, msg)                     \
+  do {                                           \
+    if (RELA_LOG_ON(level)) {                    \
+      std::ostringstream relaLogOss_;            \
+      relaLogOss_ << msg;                        \
+      ::rela::logging::write(relaLogOss_.str()); \
+    }                                            \
+  } while (0)
+
+#define RELA_TRACE(msg) RELA_LOG(::rela::kTrace, msg)
+#define RELA_DEBUG(msg) RELA_LOG(::rela::kDebug, msg)
+#define RELA_INFO(msg) RELA_LOG(::rela::kInfo, msg)
+#define RELA_WARN(msg) RELA_LOG(::rela::kWarn, msg)
+#define RELA_ERROR(msg) RELA_LOG(::rela::kError, msg)
@@ -2,9 +2,14 @@
 
 #pragma once
 
+#include <atomic>
 #include <cmath>
-#include <future>
+#include <condition_variable>
+#include <mutex>
+#include <queue>
 #include <random>
+#include <stdexcept>
+#include <thread>
 #include <vector>
 
 #include "rela/tensor_dict.h"
@@ -28,11 +33,13 @@ class PrioritizedReplay {
     rng_.seed(seed);
   }
 
+  ~PrioritizedReplay() {
+    stopSampler();
+  }
+
   void clear() {
     assert(sampledIds_.empty());
-    while (!futures_.empty()) {
-      futures_.pop();
-    }
+    stopSampler();
     storage_.clear();
     numAdd_ = 0;
     numAct_ = 0;
@@ -42,8 +49,11 @@ class PrioritizedReplay {
     alpha_ = alpha;
   }
 
+  // unblocks appends and stops the sampler thread, sample() throws after
   void terminate() {
     storage_.terminate();
+    terminated_ = true;
+    stopSampler();
   }
 
   void add(const DataType& sample, float priority) {
@@ -56,42 +66,48 @@ class PrioritizedReplay {
     add(sample, priority);
   }
 
+  // with prefetch > 0, batches are sampled ahead by one sampler thread,
+  // started by the first call, into a queue of at most prefetch batches.
+  // batchsize and device must not change between calls then
   std::tuple<DataType, torch::Tensor> sample(int batchsize, const std::string& device) {
     if (!sampledIds_.empty()) {
       std::cout << "Error: previous samples' priority has not been updated." << std::endl;
       assert(false);
     }
+    if (terminated_) {
+      throw std::runtime_error("sample from a terminated replay");
+    }
 
     DataType batch;
     torch::Tensor priority;
     if (prefetch_ == 0) {
-      std::tie(batch, priority, sampledIds_) = sample_(batchsize, device);
+      std::tie(batch, priority, sampledIds_, sampledAppendIds_) = sample_(batchsize, device);
       return std::make_tuple(batch, priority);
     }
 
-    if (futures_.empty()) {
-      std::tie(batch, priority, sampledIds_) = sample_(batchsize, device);
-    } else {
-      std::tie(batch, priority, sampledIds_) = futures_.front().get();
-      futures_.pop();
+    std::unique_lock<std::mutex> lk(mQueue_);
+    if (samplerThread_ == nullptr) {
+      samplerBatchsize_ = batchsize;
+      samplerDevice_ = device;
+      samplerThread_ = std::make_unique<std::thread>(&PrioritizedReplay::sampleLoop_, this);
+    } else if (batchsize != samplerBatchsize_ || device != samplerDevice_) {
+      throw std::runtime_error("prefetched replay sampled with a different batchsize/device");
     }
-
-    while ((int)futures_.size() < prefetch_) {
-      auto f = std::async(
-          std::launch::async,
-          &PrioritizedReplay<DataType>::sample_,
-          this,
-          batchsize,
-          device);
-      futures_.push(std::move(f));
+    cvQueue_.wait(lk, [this] { return !samples_.empty() || terminated_; });
+    if (samples_.empty()) {
+      throw std::runtime_error("sample from a terminated replay");
     }
-
+    std::tie(batch, priority, sampledIds_, sampledAppendIds_) = std::move(samples_.front());
+    samples_.pop();
+    lk.unlock();
+    cvQueue_.notify_all();
     return std::make_tuple(batch, priority);
   }
 
   void updatePriority(const torch::Tensor& priority) {
     if (priority.size(0) == 0) {
       sampledIds_.clear();
+      sampledAppendIds_.clear();
       return;
     }
 
@@ -101,9 +117,10 @@ class PrioritizedReplay {
     auto weights = torch::pow(priority, alpha_);
     {
       std::lock_guard<std::mutex> lk(mSampler_);
-      storage_.update(sampledIds_, weights);
+      storage_.update(sampledIds_, sampledAppendIds_, weights);
     }
     sampledIds_.clear();
+    sampledAppendIds_.clear();
   }
 
   DataType getFirstK(int size, const std::string& device) {
@@ -137,55 +154,59 @@ class PrioritizedReplay {
     return numAct_;
   }
  private:
-  using SampleWeightIds = std::tuple<DataType, torch::Tensor, std::vector<int>>;
+  using SampleWeightIds =
+      std::tuple<DataType, torch::Tensor, std::vector<int>, std::vector<int64_t>>;
+
+  void sampleLoop_() {
+    std::unique_lock<std::mutex> lk(mQueue_);
+    while (true) {
+      cvQueue_.wait(lk, [this] { return stopSampler_ || (int)samples_.size() < prefetch_; });
+      if (stopSampler_) {
+        return;
+      }
+      lk.unlock();
+      auto batch = sample_(samplerBatchsize_, samplerDevice_);
+      lk.lock();
+      samples_.push(std::move(batch));
+      cvQueue_.notify_all();
+    }
+  }
+
+  // joins the sampler thread and drops its batches. their priorities are
+  // never updated, which update() tolerates
+  void stopSampler() {
+    std::unique_lock<std::mutex> lk(mQueue_);
+    if (samplerThread_ == nullptr) {
+      return;
+    }
+    stopSampler_ = true;
+    lk.unlock();
+    cvQueue_.notify_all();
+    samplerThread_->join();
+    lk.lock();
+    samplerThread_.reset();
+    stopSampler_ = false;
+    samples_ = std::queue<SampleWeightIds>();
+  }
 
   SampleWeightIds sample_(int batchsize, const std::string& device) {
     std::unique_lock<std::mutex> lk(mSampler_);
 
-    float sum;
-    int size = storage_.safeSize(&sum);
+    int size = storage_.safeSize(nullptr);
     assert(size >= batchsize);
     // storage_ [0, size) remains static in the subsequent section
 
-    float segment = sum / batchsize;
-    std::uniform_real_distribution<float> dist(0.0, segment);
+    std::vector<int> indices;
+    std::vector<int> ids;
+    std::vector<int64_t> appendIds;
+    std::vector<float> w;
+    float sum = storage_.sampleIdx(batchsize, rng_, &indices, &ids, &appendIds, &w);
 
     std::vector<DataType> samples;
-    auto weights = torch::zeros({batchsize}, torch::kFloat32);
-    auto weightAcc = weights.accessor<float, 1>();
-    std::vector<int> ids(batchsize);
-
-    double accSum = 0;
-    int nextIdx = 0;
-    float w = 0;
-    int id = 0;
     for (int i = 0; i < batchsize; i++) {
-      float rand = dist(rng_) + i * segment;
-      rand = std::min(sum - (float)0.1, rand);
-
-      while (nextIdx <= size) {
-        if (accSum > 0 && accSum >= rand) {
-          assert(nextIdx >= 1);
-          DataType element = storage_.getElementAndMark(nextIdx - 1);
-          samples.push_back(element);
-          weightAcc[i] = w;
-          ids[i] = id;
-          break;
-        }
-
-        if (nextIdx == size) {
-          std::cout << "nextIdx: " << nextIdx << "/" << size << std::endl;
-          std::cout << std::setprecision(10) << "accSum: " << accSum << ", sum: " << sum
-                    << ", rand: " << rand << std::endl;
-          assert(false);
-        }
-
-        w = storage_.getWeight(nextIdx, &id);
-        accSum += w;
-        ++nextIdx;
-      }
+      samples.push_back(storage_.get(indices[i]));
     }
-    assert((int)samples.size() == batchsize);
+    auto weights = torch::tensor(w, torch::kFloat32);
 
     // pop storage if full
     size = storage_.size();
@@ -203,7 +224,7 @@ class PrioritizedReplay {
       weights = weights.to(torch::Device(device));
     }
     auto batch = makeBatch(samples, device);
-    return std::make_tuple(batch, weights, ids);
+    return std::make_tuple(batch, weights, ids, appendIds);
   }
 
   float alpha_;
@@ -211,13 +232,24 @@ class PrioritizedReplay {
   const int prefetch_;
   const int capacity_;
 
-  ConcurrentQueue<DataType> storage_;
+  ConcurrentQueue storage_;
   std::atomic<int> numAdd_;
   std::atomic<int> numAct_;
   // make sure that sample & update does not overlap
   std::mutex mSampler_;
+  // ids of the last returned batch, until updatePriority()
   std::vector<int> sampledIds_;
-  std::queue<std::future<SampleWeightIds>> futures_;
+  std::vector<int64_t> sampledAppendIds_;
+
+  // prefetched batches of the sampler thread, protected by mQueue_
+  std::unique_ptr<std::thread> samplerThread_;
+  int samplerBatchsize_ = 0;
+  std::string samplerDevice_;
+  std::queue<SampleWeightIds> samples_;
+  bool stopSampler_ = false;
+  std::mutex mQueue_;
+  std::condition_variable cvQueue_;
+  std::atomic<bool> terminated_{false};
 
   std::mt19937 rng_;
 };
@@ -5,15 +5,21 @@
 
 #include "rela/batch_runner.h"
 #include "rela/context.h"
+#include "rela/logging.h"
+#include "rela/prioritized_replay.h"
 #include "rela/replay.h"
-// #include "rela/prioritized_replay.h"
 #include "rela/thread_loop.h"
 #include "rela/transition.h"
+#include "rela/work_stealing.h"
 
 namespace py = pybind11;
 using namespace rela;
 
 PYBIND11_MODULE(rela, m) {
+  // 0: trace, 1: debug, 2: info, 3: warn, 4: error
+  m.def("set_log_level", &logging::setLevel);
+  m.def("get_log_level", &logging::getLevel);
+
   py::class_<RNNTransition, std::shared_ptr<RNNTransition>>(m, "RNNTransition")
       .def_readwrite("obs", &RNNTransition::obs)
       .def_readwrite("h0", &RNNTransition::h0)
@@ -56,56 +62,56 @@ PYBIND11_MODULE(rela, m) {
            int,    // capacity,
            int,    // seed,
            int>())
+      .def(
+          py::init<int, int, int, int, bool, int, int>(),
+          py::arg("capacity"),
+          py::arg("seed"),
+          py::arg("prefetch"),
+          py::arg("num_gather_thread") = 0,
+          py::arg("seq_first_storage") = false,
+          py::arg("step_capacity") = 0,
+          py::arg("num_shard") = 1)
       .def("clear", &Replay::clear)
       .def("terminate", &Replay::terminate)
       .def("size", &Replay::size)
       .def("num_add", &Replay::numAdd)
       .def("num_act", &Replay::numAct)
+      .def("set_obs_codec", &Replay::setObsCodec)
+      .def("bytes_per_episode", &Replay::bytesPerEpisode)
+      .def("raw_bytes_per_episode", &Replay::rawBytesPerEpisode)
+      .def("num_step", &Replay::numStep)
+      .def("num_shard", &Replay::numShard)
+      .def("set_cold_tier", &Replay::setColdTier)
+      .def("set_staging_size", &Replay::setStagingSize)
+      .def("flush_staged", &Replay::flushStaged)
+      .def("cold_size", &Replay::coldSize)
       .def("sample", &Replay::sample)
       .def("get", &Replay::get)
       .def("get_range", &Replay::getRange)
-      .def(py::pickle(
-    [](const Replay& replay) {
-        // __getstate__ (serialize)
-        std::vector<RNNTransition> storage_contents;
-        for (int i = 0; i < replay.size(); ++i) {
-            storage_contents.push_back(replay.get(i));  // Iterate and collect transitions
-        }
-
-        return py::make_tuple(
-            replay.prefetch_,
-            replay.capacity_,
-            replay.numAdd(),
-            replay.numAct(),
-            storage_contents  // Serialize collected transitions
-        );
-    },
-    [](py::tuple t) {
-        // __setstate__ (deserialize)
-        if (t.size() != 5) {  // Adjust size to reflect the correct number of elements
-            throw std::runtime_error("Invalid state!");
-        }
-
-        // Create a new instance of Replay using move semantics
-        auto replay = std::make_unique<Replay>(
-            t[1].cast<int>(),  // capacity
-            0,  // seed (we'll ignore seed during deserialization)
-            t[0].cast<int>()   // prefetch
-        );
-
-        // Restore the internal states
-        replay->numAdd_ = t[2].cast<int>();
-        replay->numAct_ = t[3].cast<unsigned long long>();
-
-        // Repopulate the storage by iterating over the deserialized transitions
-        std::vector<RNNTransition> storage_contents = t[4].cast<std::vector<RNNTransition>>();
-        for (const auto& transition : storage_contents) {
-            replay->storage_.append(transition, 1);  // Append deserialized transitions
-        }
-
-        return replay;  // Return the unique pointer to the Replay instance
-    }
-));
+      .def("save_snapshot", &Replay::saveSnapshot, py::call_guard<py::gil_scoped_release>())
+      .def("load_snapshot", &Replay::loadSnapshot, py::call_guard<py::gil_scoped_release>());
+
+  py::class_<RNNPrioritizedReplay, std::shared_ptr<RNNPrioritizedReplay>>(
+      m, "RNNPrioritizedReplay")
+      .def(
+          py::init<int, int, float, float, int>(),
+          py::arg("capacity"),
+          py::arg("seed"),
+          py::arg("alpha"),
+          py::arg("beta"),
+          py::arg("prefetch"))
+      .def("clear", &RNNPrioritizedReplay::clear)
+      .def("terminate", &RNNPrioritizedReplay::terminate)
+      .def("size", &RNNPrioritizedReplay::size)
+      .def("num_add", &RNNPrioritizedReplay::numAdd)
+      .def("num_act", &RNNPrioritizedReplay::numAct)
+      .def("reset_alpha", &RNNPrioritizedReplay::resetAlpha)
+      .def("add", py::overload_cast<const RNNTransition&, float>(&RNNPrioritizedReplay::add))
+      // waits for the sampler thread, terminate() may be called meanwhile
+      .def("sample", &RNNPrioritizedReplay::sample, py::call_guard<py::gil_scoped_release>())
+      .def("update_priority", &RNNPrioritizedReplay::updatePriority)
+      .def("get", &RNNPrioritizedReplay::get)
+      .def("get_range", &RNNPrioritizedReplay::getRange);
 
 
   py::class_<ThreadLoop, std::shared_ptr<ThreadLoop>>(m, "ThreadLoop");
@@ -120,19 +126,65 @@ PYBIND11_MODULE(rela, m) {
       .def("join", &Context::join)
       .def("terminated", &Context::terminated);
 
+  py::class_<TaskSet, std::shared_ptr<TaskSet>>(m, "TaskSet");
+
+  py::class_<WorkStealingExecutor, std::shared_ptr<WorkStealingExecutor>>(
+      m, "WorkStealingExecutor")
+      .def(py::init<std::shared_ptr<TaskSet>, int>())
+      .def("reset", &WorkStealingExecutor::reset)
+      .def("num_steal", &WorkStealingExecutor::numSteal);
+
+  py::class_<WorkStealingLoop, ThreadLoop, std::shared_ptr<WorkStealingLoop>>(
+      m, "WorkStealingLoop")
+      .def(py::init<std::shared_ptr<WorkStealingExecutor>, int>());
+
+  py::class_<BatchPolicy>(m, "BatchPolicy")
+      .def(py::init<>())
+      .def(
+          py::init<int, int, int>(),
+          py::arg("min_batchsize") = 1,
+          py::arg("max_wait_us") = 0,
+          py::arg("target_latency_us") = 0)
+      .def_readwrite("min_batchsize", &BatchPolicy::minBatchsize)
+      .def_readwrite("max_wait_us", &BatchPolicy::maxWaitUs)
+      .def_readwrite("target_latency_us", &BatchPolicy::targetLatencyUs);
+
   py::class_<BatchRunner, std::shared_ptr<BatchRunner>>(m, "BatchRunner")
-      .def(py::init<
-           py::object,
-           const std::string&,
-           int,
-           const std::vector<std::string>&>())
-      .def(py::init<py::object, const std::string&>())
-      .def("add_method", &BatchRunner::addMethod)
+      .def(
+          py::init<
+              py::object,
+              const std::string&,
+              int,
+              const std::vector<std::string>&,
+              bool>(),
+          py::arg("py_model"),
+          py::arg("device"),
+          py::arg("max_batchsize"),
+          py::arg("methods"),
+          py::arg("lock_free_batcher") = false)
+      .def(
+          py::init<py::object, const std::string&, bool>(),
+          py::arg("py_model"),
+          py::arg("device"),
+          py::arg("lock_free_batcher") = false)
+      .def(
+          "add_method",
+          &BatchRunner::addMethod,
+          py::arg("method"),
+          py::arg("batch_size"),
+          py::arg("policy") = BatchPolicy())
       .def("start", &BatchRunner::start)
       .def("stop", &BatchRunner::stop)
       .def("acquire_model_lock", &BatchRunner::acquireModelLock)
       .def("release_model_lock", &BatchRunner::releaseModelLock)
       .def("update_model", &BatchRunner::updateModel)
       .def("set_log_freq", &BatchRunner::setLogFreq)
+      .def("set_num_worker", &BatchRunner::setNumWorker)
+      .def("set_version_key", &BatchRunner::setVersionKey)
+      .def("model_version", &BatchRunner::modelVersion)
+      .def("set_num_buffer", &BatchRunner::setNumBuffer)
+      .def("get_batcher_stats", &BatchRunner::getBatcherStats)
+      .def("get_histograms", &BatchRunner::getHistograms)
+      .def("reset_histograms", &BatchRunner::resetHistograms)
       .def("log_and_clear_agg_size", &BatchRunner::logAndClearAggSize);
 }
@@ -0,0 +1,156 @@
+// Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved
+
+#include "rela/ragged_storage.h"
+#include "rela/batcher.h"
+
+using namespace rela;
+
+static TensorDict allocateStepStorage(const TensorDict& data, int numStep) {
+  TensorDict storage;
+  for (const auto& kv : data) {
+    auto sizes = getBatchedSize(kv.second[0], numStep);
+    storage[kv.first] = torch::zeros(sizes, kv.second.dtype());
+  }
+  return storage;
+}
+
+// [T, bsz, ...] for per step fields stored as [numStep, ...]
+static torch::Tensor allocateStepBatch(
+    const torch::Tensor& storage, int maxSeqLen, int bsz, bool pinned) {
+  auto sizes = storage.sizes().vec();
+  sizes[0] = bsz;
+  sizes.insert(sizes.begin(), maxSeqLen);
+  auto options = torch::TensorOptions().dtype(storage.dtype()).pinned_memory(pinned);
+  return torch::empty(sizes, options);
+}
+
+// steps [T * n] of the batch, padding reads step offset and is masked out
+static void gatherSteps(
+    const torch::Tensor& storage,
+    const torch::Tensor& stepIds,
+    const torch::Tensor& pad,
+    torch::Tensor& dst,
+    int begin) {
+  int n = pad.size(1);
+  auto sizes = storage.sizes().vec();
+  sizes[0] = n;
+  sizes.insert(sizes.begin(), pad.size(0));
+  auto rows = storage.index_select(0, stepIds).view(sizes);
+  auto padSizes = pad.sizes().vec();
+  padSizes.resize(rows.dim(), 1);
+  rows.masked_fill_(pad.view(padSizes), 0);
+  dst.narrow(1, begin, n).copy_(rows);
+}
+
+RaggedStorage::RaggedStorage(const RNNTransition& tau, int capacity, int numStep)
+    : numStep_(numStep) {
+  maxSeqLen_ = tau.reward.size(0);
+  data_.isStorage = true;
+  data_.obs = allocateStepStorage(tau.obs, numStep);
+  data_.action = allocateStepStorage(tau.action, numStep);
+  data_.reward = torch::zeros(numStep);
+  data_.bootstrap = torch::zeros(numStep);
+  data_.h0 = allocateBatchStorage(tau.h0, capacity);
+  data_.seqLen = torch::zeros(capacity);
+}
+
+int64_t RaggedStorage::bytes() const {
+  int64_t bytes = data_.reward.nbytes() + data_.bootstrap.nbytes() + data_.seqLen.nbytes();
+  for (const auto* dict : {&data_.obs, &data_.h0, &data_.action}) {
+    for (const auto& kv : *dict) {
+      bytes += kv.second.nbytes();
+    }
+  }
+  return bytes;
+}
+
+void RaggedStorage::paste_(const RNNTransition& tau, int idx, int offset, int len) {
+  assert(len > 0 && len <= maxSeqLen_ && offset + len <= numStep_);
+  for (auto& kv : tau.obs) {
+    data_.obs[kv.first].narrow(0, offset, len).copy_(kv.second.narrow(0, 0, len));
+  }
+  for (auto& kv : tau.action) {
+    data_.action[kv.first].narrow(0, offset, len).copy_(kv.second.narrow(0, 0, len));
+  }
+  data_.reward.narrow(0, offset, len).copy_(tau.reward.narrow(0, 0, len));
+  data_.bootstrap.narrow(0, offset, len).copy_(tau.bootstrap.narrow(0, 0, len));
+  for (auto& kv : tau.h0) {
+    data_.h0[kv.first][idx] = kv.second;
+  }
+  data_.seqLen[idx] = tau.seqLen;
+}
+
+RNNTransition RaggedStorage::index(int idx, int offset, int len) const {
+  auto padded = [&](const torch::Tensor& storage) {
+    auto sizes = storage.sizes().vec();
+    sizes[0] = maxSeqLen_;
+    auto t = torch::zeros(sizes, storage.dtype());
+    t.narrow(0, 0, len).copy_(storage.narrow(0, offset, len));
+    return t;
+  };
+
+  RNNTransition element;
+  for (auto& kv : data_.obs) {
+    element.obs.insert({kv.first, padded(kv.second)});
+  }
+  for (auto& kv : data_.action) {
+    element.action.insert({kv.first, padded(kv.second)});
+  }
+  for (auto& kv : data_.h0) {
+    element.h0.insert({kv.first, kv.second[idx]});
+  }
+  element.reward = padded(data_.reward);
+  element.bootstrap = padded(data_.bootstrap);
+  element.seqLen = data_.seqLen[idx];
+  return element;
+}
+
+RNNTransition RaggedStorage::allocateSeqFirst(int bsz, bool pinned) const {
+  RNNTransition batch;
+  for (auto& kv : data_.obs) {
+    batch.obs[kv.first] = allocateStepBatch(kv.second, maxSeqLen_, bsz, pinned);
+  }
+  for (auto& kv : data_.action) {
+    batch.action[kv.first] = allocateStepBatch(kv.second, maxSeqLen_, bsz, pinned);
+  }
+  batch.reward = allocateStepBatch(data_.reward, maxSeqLen_, bsz, pinned);
+  batch.bootstrap = allocateStepBatch(data_.bootstrap, maxSeqLen_, bsz, pinned);
+  auto options = [&](const torch::Tensor& t) {
+    return torch::TensorOptions().dtype(t.dtype()).pinned_memory(pinned);
+  };
+  for (auto& kv : data_.h0) {
+    auto sizes = kv.second.sizes().vec();
+    sizes[0] = bsz;
+    std::swap(sizes[0], sizes[1]);
+    batch.h0[kv.first] = torch::empty(sizes, options(kv.second));
+  }
+  batch.seqLen = torch::empty({bsz}, options(data_.seqLen));
+  return batch;
+}
+
+void RaggedStorage::gatherSeqFirst(
+    const torch::Tensor& ids,
+    const torch::Tensor& offsets,
+    const torch::Tensor& lens,
+    RNNTransition& dst,
+    int begin) const {
+  int n = ids.size(0);
+  auto steps = torch::arange(maxSeqLen_, torch::kInt64).unsqueeze(1);
+  auto pad = steps >= lens.unsqueeze(0);
+  auto stepIds = (offsets.unsqueeze(0) + steps * pad.logical_not()).view({-1});
+
+  for (auto& kv : data_.obs) {
+    gatherSteps(kv.second, stepIds, pad, dst.obs.at(kv.first), begin);
+  }
+  for (auto& kv : data_.action) {
+    gatherSteps(kv.second, stepIds, pad, dst.action.at(kv.first), begin);
+  }
+  gatherSteps(data_.reward, stepIds, pad, dst.reward, begin);
+  gatherSteps(data_.bootstrap, stepIds, pad, dst.bootstrap, begin);
+
+  for (auto& kv : data_.h0) {
+    auto rows = kv.second.index_select(0, ids);
+    dst.h0.at(kv.first).narrow(1, begin, n).copy_(rows.transpose(0, 1));
+  }
+  dst.seqLen.narrow(0, begin, n).copy_(data_.seqLen.index_select(0, ids));
+}
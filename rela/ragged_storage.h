@@ -0,0 +1,67 @@
+// Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved
+
+#pragma once
+
+#include "rela/tensor_dict.h"
+#include "rela/transition.h"
+
+namespace rela {
+
+// Replay storage that keeps only the seqLen valid steps of each episode.
+// Per step fields (obs, action, reward, bootstrap) live in one arena of
+// numStep steps, episode idx occupies arena steps [offset, offset + len)
+// with offset and len managed by the caller. h0 and seqLen are stored per
+// episode. Padding to the max seqLen is only materialized, as zeros, when an
+// episode or a batch is read.
+class RaggedStorage {
+ public:
+  // tau: an element, i.e. [maxSeqLen, ...] per step fields
+  RaggedStorage(const RNNTransition& tau, int capacity, int numStep);
+
+  // storage from data() and maxSeqLen() of another one, e.g. a snapshot
+  RaggedStorage(RNNTransition data, int maxSeqLen)
+      : numStep_(data.reward.size(0))
+      , maxSeqLen_(maxSeqLen)
+      , data_(std::move(data)) {
+  }
+
+  const RNNTransition& data() const {
+    return data_;
+  }
+
+  int maxSeqLen() const {
+    return maxSeqLen_;
+  }
+
+  int numStep() const {
+    return numStep_;
+  }
+
+  int64_t bytes() const;
+
+  // store the first len steps of tau
+  void paste_(const RNNTransition& tau, int idx, int offset, int len);
+
+  // episode padded to maxSeqLen
+  RNNTransition index(int idx, int offset, int len) const;
+
+  // uninitialized batch in the layout of RNNTransition::seqFirst_()
+  RNNTransition allocateSeqFirst(int bsz, bool pinned) const;
+
+  // fill elements [begin, begin + n) of a seq first batch with episodes ids,
+  // offsets and lens are their arena ranges, all int64 of size n
+  void gatherSeqFirst(
+      const torch::Tensor& ids,
+      const torch::Tensor& offsets,
+      const torch::Tensor& lens,
+      RNNTransition& dst,
+      int begin) const;
+
+ private:
+  const int numStep_;
+  int maxSeqLen_;
+  // per step fields are [numStep, ...], h0 [capacity, ...], seqLen [capacity]
+  RNNTransition data_;
+};
+
+}  // namespace rela
@@ -0,0 +1,67 @@
+// Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+namespace rela {
+
+// Tags of the consumers (e.g. env indices of a thread loop) whose
+// FutureReply has been set. Runner threads push, the owning thread pops and
+// blocks while nothing is ready. A tag may be pushed more than once.
+class ReadyQueue {
+ public:
+  void push(int tag) {
+    {
+      std::lock_guard<std::mutex> lk(m_);
+      tags_.push_back(tag);
+    }
+    cv_.notify_one();
+  }
+
+  void push(const std::vector<int>& tags) {
+    {
+      std::lock_guard<std::mutex> lk(m_);
+      tags_.insert(tags_.end(), tags.begin(), tags.end());
+    }
+    cv_.notify_one();
+  }
+
+  // the next count popAll() calls return even if no tag is ready, e.g. to
+  // wake a consumer that has other work or has to exit
+  void interrupt(int count) {
+    {
+      std::lock_guard<std::mutex> lk(m_);
+      numInterrupt_ += count;
+    }
+    cv_.notify_all();
+  }
+
+  // move every ready tag into out, waits up to timeout if there is none.
+  // returns false on timeout
+  template <class Rep, class Period>
+  bool popAll(std::vector<int>& out, const std::chrono::duration<Rep, Period>& timeout) {
+    std::unique_lock<std::mutex> lk(m_);
+    if (!cv_.wait_for(
+            lk, timeout, [this] { return !tags_.empty() || numInterrupt_ > 0; })) {
+      return false;
+    }
+    if (numInterrupt_ > 0) {
+      --numInterrupt_;
+    }
+    out.insert(out.end(), tags_.begin(), tags_.end());
+    tags_.clear();
+    return true;
+  }
+
+ private:
+  std::mutex m_;
+  std::condition_variable cv_;
+  std::vector<int> tags_;
+  int numInterrupt_ = 0;
+};
+
+}  // namespace rela
@@ -1,63 +1,157 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <memory>
+#include <stdexcept>
 #include <random>
 #include <thread>
 #include <vector>
 #include <queue>
 #include <typeinfo>
+#include <unordered_map>
 
 #include "rela/tensor_dict.h"
 #include "rela/transition.h"
+#include "rela/cold_storage.h"
 #include "rela/concurrent_queue.h"
+#include "rela/snapshot.h"
+
+#include <sys/stat.h>
 
 namespace rela {
 
+// thread index in order of first call, used to give each thread its own
+// replay shard
+inline int threadSlot() {
+  static std::atomic<int> numThread{0};
+  thread_local int slot = numThread++;
+  return slot;
+}
+
+// numShard > 1 splits the storage into independent queues of capacity /
+// numShard. add() appends to the shard of the calling thread, so actors on
+// different threads neither share a lock nor wait for each other to finish
+// pasting. sampling is stratified over all shards in order
 class Replay {
  public:
-  Replay(int capacity, int seed, int prefetch)
+  Replay(
+      int capacity,
+      int seed,
+      int prefetch,
+      int numGatherThread = 0,
+      bool seqFirstStorage = false,
+      int stepCapacity = 0,
+      int numShard = 1)
       : prefetch_(prefetch)
       , capacity_(capacity)
-      , storage_(int(1.25 * capacity))
+      , stepCapacity_(stepCapacity)
+      , replayId_(nextReplayId())
       , numAdd_(0)
       , numAct_(0) {
+    assert(numShard >= 1);
     rng_.seed(seed);
+    for (int i = 0; i < numShard; ++i) {
+      storage_.push_back(std::make_unique<ConcurrentQueue>(
+          int(1.25 * capacity / numShard),
+          seqFirstStorage,
+          int(1.25 * stepCapacity / numShard)));
+    }
+    if (numGatherThread > 0) {
+      gatherPool_ = std::make_unique<ThreadPool>(numGatherThread);
+    }
+  }
+
+  ~Replay() {
+    stopSampler();
   }
 
   void clear() {
     assert(false); // not yet checked after switching to thread
 
-    storage_.clear();
+    for (auto& shard : storage_) {
+      shard->clear();
+    }
     numAdd_ = 0;
     numAct_ = 0;
   }
 
+  // unblocks appends and stops the sampler thread, sample() throws after
   void terminate() {
-    storage_.terminate();
+    for (auto& shard : storage_) {
+      shard->terminate();
+    }
+    if (cold_ != nullptr) {
+      cold_->terminate();
+    }
+    terminated_ = true;
+    stopSampler();
   }
 
   void add(const RNNTransition& sample) {
-    numAdd_ += 1;
-    numAct_ += static_cast<unsigned long long >(sample.seqLen.item<int>());
+    if (stagingSize_ <= 1) {
+      numAdd_ += 1;
+      numAct_ += static_cast<unsigned long long >(sample.seqLen.item<int>());
 
-    storage_.append(sample, 1);
+      storage_[threadSlot() % storage_.size()]->append(sample, 1);
+      return;
+    }
+
+    auto& staging = threadStaging();
+    std::lock_guard<std::mutex> lk(staging.m);
+    if (staging.block == nullptr) {
+      staging.block = std::make_unique<RNNTransition>(sample, stagingSize_);
+    }
+    staging.block->paste_(sample, staging.size);
+    ++staging.size;
+    if (staging.size == stagingSize_) {
+      addStaged(staging);
+    }
+  }
+
+  // > 1: add() pastes episodes into a staging block of the calling thread,
+  // which is appended to the storage every n episodes with a single lock of
+  // the shard and one copy per key. staged episodes are not sampled until
+  // then, or until flushStaged(), which saveSnapshot() also calls. must be
+  // called before the first add
+  void setStagingSize(int n) {
+    stagingSize_ = n;
   }
 
+  // append the partial staging blocks of all threads
+  void flushStaged() {
+    std::lock_guard<std::mutex> lk(mStaging_);
+    for (auto& staging : staging_) {
+      std::lock_guard<std::mutex> lkStaging(staging->m);
+      if (staging->size > 0) {
+        addStaged(*staging);
+      }
+    }
+  }
+
+  // with prefetch > 0, the first call starts a sampler thread that keeps
+  // prefetch batches of batchsize ready
   RNNTransition sample(int batchsize, const std::string& device) {
+    if (terminated_) {
+      throw std::runtime_error("sample from a terminated replay");
+    }
     // simple, single thread version
     if (prefetch_ == 0) {
       return sample_(batchsize, device);
     }
 
+    std::unique_lock<std::mutex> lk(mSampler_);
     if (samplerThread_ == nullptr) {
       // create sampler thread
       samplerThread_ = std::make_unique<std::thread>(
           &Replay::sampleLoop_, this, batchsize, device);
     }
 
-    // std::cout << "Try to get batch" << std::endl;
-    std::unique_lock<std::mutex> lk(mSampler_);
-    cvSampler_.wait(lk, [this] {return samples_.size() > 0;});
-    // std::cout << "Get Batch" << std::endl;
+    cvSampler_.wait(lk, [this] { return samples_.size() > 0 || terminated_; });
+    if (samples_.empty()) {
+      throw std::runtime_error("sample from a terminated replay");
+    }
 
     auto batch = samples_.front();
     samples_.pop();
@@ -68,20 +162,130 @@ class Replay {
     return batch;
   }
 
+  // elements are indexed shard after shard
   RNNTransition get(int idx) const {
-    return storage_.get(idx);
+    for (auto& shard : storage_) {
+      int size = shard->safeSize(nullptr);
+      if (idx < size) {
+        return shard->get(idx);
+      }
+      idx -= size;
+    }
+    assert(false);
+    return RNNTransition();
   }
 
   RNNTransition getRange(int start, int end, const std::string& device) {
     std::vector<RNNTransition> samples;
     for (int i = start; i < end; ++i) {
-      samples.push_back(storage_.get(i));
+      samples.push_back(get(i));
     };
     return makeBatch(samples, device);
   }
 
   int size() const {
-    return storage_.safeSize(nullptr);
+    int size = 0;
+    for (auto& shard : storage_) {
+      size += shard->safeSize(nullptr);
+    }
+    return size;
+  }
+
+  int numShard() const {
+    return (int)storage_.size();
+  }
+
+  // second tier on disk, see ColdStorage: episodes popped from the shards
+  // are spilled to dir, at most capacity of them, and once some are cached
+  // sampleRatio of each batch is drawn from the cacheSize cached ones.
+  // must be called before sampling
+  void setColdTier(
+      const std::string& dir, int capacity, int chunkSize, int cacheSize, float sampleRatio) {
+    if (sampleRatio < 0 || sampleRatio >= 1) {
+      throw std::runtime_error("cold sample ratio must be in [0, 1)");
+    }
+    if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+      throw std::runtime_error("failed to create cold replay directory " + dir);
+    }
+    cold_ = std::make_unique<ColdStorage>(dir, capacity, chunkSize, cacheSize, rng_());
+    coldRatio_ = sampleRatio;
+  }
+
+  // episodes in the cold tier
+  int coldSize() const {
+    return cold_ == nullptr ? 0 : cold_->size();
+  }
+
+  void setObsCodec(const std::string& key, const std::string& kind, int size) {
+    for (auto& shard : storage_) {
+      shard->setObsCodec(key, kind, size);
+    }
+  }
+
+  // shards that have not received an element yet report 0
+  int64_t bytesPerEpisode() const {
+    int64_t bytes = 0;
+    for (auto& shard : storage_) {
+      bytes = std::max(bytes, shard->bytesPerElement());
+    }
+    return bytes;
+  }
+
+  int64_t rawBytesPerEpisode() const {
+    int64_t bytes = 0;
+    for (auto& shard : storage_) {
+      bytes = std::max(bytes, shard->rawBytesPerElement());
+    }
+    return bytes;
+  }
+
+  int numStep() const {
+    int numStep = 0;
+    for (auto& shard : storage_) {
+      numStep += shard->numStepUsed();
+    }
+    return numStep;
+  }
+
+  // native snapshot in directory path: one file per shard, streamed while
+  // pops of that shard wait, then the counters. loadSnapshot() needs a replay
+  // constructed with the same arguments that has not been added to yet and
+  // maps the files instead of reading them. staged episodes are appended
+  // first so that they are part of the snapshot
+  void saveSnapshot(const std::string& path) {
+    flushStaged();
+    if (mkdir(path.c_str(), 0755) != 0 && errno != EEXIST) {
+      throw std::runtime_error("failed to create snapshot directory " + path);
+    }
+    for (int k = 0; k < (int)storage_.size(); ++k) {
+      storage_[k]->saveSnapshot(path + "/shard" + std::to_string(k));
+    }
+    SnapshotWriter writer(path + "/replay");
+    writer.writeInt(storage_.size());
+    writer.writeInt(capacity_);
+    writer.writeInt(stepCapacity_);
+    writer.writeInt(numAdd_);
+    writer.writeInt(numAct_);
+    writer.close();
+  }
+
+  void loadSnapshot(const std::string& path) {
+    SnapshotReader reader(path + "/replay");
+    int numShard = reader.readInt();
+    int capacity = reader.readInt();
+    int stepCapacity = reader.readInt();
+    if (numShard != (int)storage_.size() || capacity != capacity_
+        || stepCapacity != stepCapacity_) {
+      throw std::runtime_error(
+          "snapshot " + path + " has " + std::to_string(numShard) + " shards, capacity "
+          + std::to_string(capacity) + ", stepCapacity " + std::to_string(stepCapacity)
+          + ", not the ones of this replay");
+    }
+    for (int k = 0; k < numShard; ++k) {
+      storage_[k]->loadSnapshot(path + "/shard" + std::to_string(k));
+    }
+    numAdd_ = reader.readInt();
+    numAct_ = reader.readInt();
   }
 
   int numAdd() const {
@@ -91,50 +295,154 @@ class Replay {
     return numAct_;
   }
 
+  // samples only when the queue has room, so the batches handed out are
+  // at most prefetch_ batches old
   void sampleLoop_(int batchsize, const std::string& device) {
+    std::unique_lock<std::mutex> lk(mSampler_);
     while (true) {
+      cvSampler_.wait(
+          lk, [this] { return stopSampler_ || (int)samples_.size() < prefetch_; });
+      if (stopSampler_) {
+        return;
+      }
+      lk.unlock();
       auto batch = sample_(batchsize, device);
-
-      std::unique_lock<std::mutex> lk(mSampler_);
-      cvSampler_.wait(lk, [this] {return (int)samples_.size() < prefetch_;});
+      lk.lock();
       samples_.push(batch);
-      // std::cout << "samples size: " << samples_.size() << std::endl;
-      lk.unlock();
       cvSampler_.notify_all();
     }
   }
 
+  void stopSampler() {
+    std::unique_lock<std::mutex> lk(mSampler_);
+    if (samplerThread_ == nullptr) {
+      return;
+    }
+    stopSampler_ = true;
+    lk.unlock();
+    cvSampler_.notify_all();
+    samplerThread_->join();
+    lk.lock();
+    samplerThread_.reset();
+    stopSampler_ = false;
+    samples_ = std::queue<RNNTransition>();
+  }
+
   RNNTransition sample_(int batchsize, const std::string& device) {
-    float sum;
-    int size = storage_.safeSize(&sum);
-    assert(int(sum) == size);
-    assert(size >= batchsize);
+    int numShard = (int)storage_.size();
+    std::vector<int> sizes(numShard);
+    int size = 0;
+    int first = -1;
+    for (int k = 0; k < numShard; ++k) {
+      float sum;
+      sizes[k] = storage_[k]->safeSize(&sum);
+      assert(int(sum) == sizes[k]);
+      size += sizes[k];
+      if (first < 0 && sizes[k] > 0) {
+        first = k;
+      }
+    }
+    // the last numCold elements of the batch come from the cold tier
+    int numCold = 0;
+    if (cold_ != nullptr && cold_->numCached() > 0) {
+      numCold = std::min(int(coldRatio_ * batchsize + 0.5f), batchsize - 1);
+    }
+    int numHot = batchsize - numCold;
+    assert(size >= numHot);
     // storage_ [0, size) remains static in the subsequent section
-    int segment = size / batchsize;
+    int segment = size / numHot;
     std::uniform_int_distribution<int> dist(0, segment-1);
 
-    assert(batchsize > 0);
-    RNNTransition batch(storage_.get(0), batchsize);
+    // indices are increasing, each shard takes a contiguous part of the batch
+    assert(numHot > 0);
+    std::vector<std::vector<int>> indices(numShard);
+    int shard = 0;
+    int shardBegin = 0;
+    for (int i = 0; i < numHot; ++i) {
+      int idx = dist(rng_) + i * segment;
+      assert(idx < size);
+      while (idx >= shardBegin + sizes[shard]) {
+        shardBegin += sizes[shard];
+        ++shard;
+      }
+      indices[shard].push_back(idx - shardBegin);
+    }
 
-    // RNNTransition batch;
-    for (int i = 0; i < batchsize; ++i) {
-      int rand = dist(rng_) + i * segment;
-      assert(rand < size);
-      storage_.copyTo(rand, batch, i);
+    // gathered straight into [seqLen, batchsize, ...], pinned so that
+    // the copy to device does not go through a staging buffer
+    auto batch = storage_[first]->allocateSeqFirst(batchsize, device != "cpu");
+    int begin = 0;
+    for (int k = 0; k < numShard; ++k) {
+      storage_[k]->gatherSeqFirst(indices[k], batch, begin, gatherPool_.get());
+      begin += (int)indices[k].size();
+    }
+    if (numCold > 0) {
+      cold_->sampleSeqFirst(numCold, rng_, batch, begin);
     }
+    batch.to_(device);
+    batch = storage_[first]->decode(batch);
 
     // pop storage if full
-    size = storage_.size();
-    if (size > capacity_) {
-      storage_.blockPop(size - capacity_);
+    for (auto& shard : storage_) {
+      int numPop = shard->numOverflow(capacity_ / numShard, stepCapacity_ / numShard);
+      if (numPop > 0) {
+        if (cold_ != nullptr) {
+          // the popped elements are safe and not yet overwritten
+          for (int i = 0; i < numPop; ++i) {
+            cold_->append(shard->getEncoded(i));
+          }
+        }
+        shard->blockPop(numPop);
+      }
     }
-    batch.seqFirst_();
-    batch.to_(device);
     return batch;
   }
 
+  struct Staging {
+    // shard of the owning thread, also used when flushStaged() appends
+    int shard = 0;
+    // only contended by flushStaged()
+    std::mutex m;
+    std::unique_ptr<RNNTransition> block;
+    int size = 0;
+  };
+
+  // staging of the calling thread, created on its first call
+  Staging& threadStaging() {
+    // keyed by an id rather than this, which a later replay may reuse
+    thread_local std::unordered_map<int64_t, Staging*> threadStaging;
+    auto it = threadStaging.find(replayId_);
+    if (it != threadStaging.end()) {
+      return *it->second;
+    }
+    std::lock_guard<std::mutex> lk(mStaging_);
+    staging_.push_back(std::make_unique<Staging>());
+    staging_.back()->shard = threadSlot() % storage_.size();
+    threadStaging[replayId_] = staging_.back().get();
+    return *staging_.back();
+  }
+
+  static int64_t nextReplayId() {
+    static std::atomic<int64_t> numReplay{0};
+    return numReplay++;
+  }
+
+  // with staging.m held
+  void addStaged(Staging& staging) {
+    int n = staging.size;
+    auto seqLen = staging.block->seqLen.narrow(0, 0, n).sum().item<float>();
+    numAdd_ += n;
+    numAct_ += static_cast<unsigned long long>(seqLen);
+    storage_[staging.shard]->appendBlock(*staging.block, n, 1);
+    staging.size = 0;
+  }
+
   const int prefetch_;
   const int capacity_;
+  // > 0: episodes are stored without padding and at most stepCapacity_ of
+  // their steps are kept, with 25% slack for appends in flight. sample()
+  // pops beyond that when the arena has no room for the largest block
+  const int stepCapacity_;
 
   // make sure that multiple calls of sample does not overlap
   std::unique_ptr<std::thread> samplerThread_;
@@ -142,8 +450,21 @@ class Replay {
   std::queue<RNNTransition> samples_;
   std::mutex mSampler_;
   std::condition_variable cvSampler_;
+  bool stopSampler_ = false;
+  std::atomic<bool> terminated_{false};
+
+  // shards of the storage, never resized
+  std::vector<std::unique_ptr<ConcurrentQueue>> storage_;
+  // splits the batch gather of sample_, nullptr: gather on the caller
+  std::unique_ptr<ThreadPool> gatherPool_;
+  // disk tier, nullptr if not set
+  std::unique_ptr<ColdStorage> cold_;
+  float coldRatio_ = 0;
+  int stagingSize_ = 1;
+  std::mutex mStaging_;
+  std::vector<std::unique_ptr<Staging>> staging_;
+  const int64_t replayId_;
 
-  ConcurrentQueue storage_;
   std::atomic<int> numAdd_;
   std::atomic<unsigned long long > numAct_;
   std::mt19937 rng_;
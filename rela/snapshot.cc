@@ -0,0 +1,219 @@
+// Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved
+
+#include "rela/snapshot.h"
+
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace rela;
+
+static const char kMagic[8] = {'R', 'E', 'L', 'A', 'S', 'N', 'P', '1'};
+
+static int64_t alignSnapshot(int64_t bytes) {
+  return (bytes + kSnapshotAlign - 1) / kSnapshotAlign * kSnapshotAlign;
+}
+
+static void writeAll(FILE* f, const void* data, size_t n, const std::string& path) {
+  if (n > 0 && fwrite(data, 1, n, f) != n) {
+    fclose(f);
+    throw std::runtime_error("failed to write snapshot " + path);
+  }
+}
+
+static void writePadding(FILE* f, int64_t n, const std::string& path) {
+  static const char zeros[kSnapshotAlign] = {0};
+  assert(n >= 0 && n < kSnapshotAlign);
+  writeAll(f, zeros, n, path);
+}
+
+void SnapshotWriter::writeInt(int64_t v) {
+  header_.append(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+void SnapshotWriter::writeString(const std::string& s) {
+  writeInt((int64_t)s.size());
+  header_.append(s);
+}
+
+void SnapshotWriter::writeTensor(const torch::Tensor& t) {
+  assert(t.device().is_cpu() && t.is_contiguous());
+  writeInt((int64_t)t.scalar_type());
+  writeInt(t.dim());
+  for (int i = 0; i < t.dim(); ++i) {
+    writeInt(t.size(i));
+  }
+  // offset of the blob from the first blob
+  writeInt(blobBytes_);
+  blobBytes_ += alignSnapshot(t.nbytes());
+  blobs_.push_back(t);
+}
+
+void SnapshotWriter::writeTransition(const RNNTransition& t) {
+  for (const auto* dict : {&t.obs, &t.h0, &t.action}) {
+    writeInt(dict->size());
+    for (const auto& kv : *dict) {
+      writeString(kv.first);
+      writeTensor(kv.second);
+    }
+  }
+  writeTensor(t.reward);
+  writeTensor(t.bootstrap);
+  writeTensor(t.seqLen);
+}
+
+void SnapshotWriter::close() {
+  std::string tmpPath = path_ + ".tmp";
+  FILE* f = fopen(tmpPath.c_str(), "wb");
+  if (f == nullptr) {
+    throw std::runtime_error("failed to open snapshot " + tmpPath);
+  }
+
+  int64_t headerSize = header_.size();
+  writeAll(f, kMagic, sizeof(kMagic), tmpPath);
+  writeAll(f, &headerSize, sizeof(headerSize), tmpPath);
+  writeAll(f, header_.data(), header_.size(), tmpPath);
+  int64_t pos = sizeof(kMagic) + sizeof(headerSize) + headerSize;
+  writePadding(f, alignSnapshot(pos) - pos, tmpPath);
+
+  for (const auto& t : blobs_) {
+    int64_t nbytes = t.nbytes();
+    writeAll(f, t.data_ptr(), nbytes, tmpPath);
+    writePadding(f, alignSnapshot(nbytes) - nbytes, tmpPath);
+  }
+  blobs_.clear();
+
+  if (fflush(f) != 0 || fsync(fileno(f)) != 0) {
+    fclose(f);
+    throw std::runtime_error("failed to flush snapshot " + tmpPath);
+  }
+  fclose(f);
+  if (rename(tmpPath.c_str(), path_.c_str()) != 0) {
+    throw std::runtime_error("failed to rename snapshot " + tmpPath);
+  }
+}
+
+struct SnapshotReader::Mapping {
+  ~Mapping() {
+    if (data != nullptr) {
+      munmap(data, size);
+    }
+  }
+
+  void* data = nullptr;
+  size_t size = 0;
+};
+
+SnapshotReader::SnapshotReader(const std::string& path)
+    : path_(path)
+    , mapping_(std::make_shared<Mapping>()) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("failed to open snapshot " + path);
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    ::close(fd);
+    throw std::runtime_error("failed to stat snapshot " + path);
+  }
+  mapping_->size = st.st_size;
+  // private: writes to the tensors go to anonymous copies of the pages
+  void* data = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    throw std::runtime_error("failed to map snapshot " + path);
+  }
+  mapping_->data = data;
+
+  const char* base = static_cast<const char*>(data);
+  if (mapping_->size < sizeof(kMagic) + sizeof(int64_t)
+      || memcmp(base, kMagic, sizeof(kMagic)) != 0) {
+    throw std::runtime_error("not a snapshot: " + path);
+  }
+  memcpy(&headerSize_, base + sizeof(kMagic), sizeof(headerSize_));
+  int64_t maxHeaderSize = mapping_->size - sizeof(kMagic) - sizeof(headerSize_);
+  if (headerSize_ < 0 || headerSize_ > maxHeaderSize) {
+    throw std::runtime_error("corrupt snapshot header " + path);
+  }
+  header_ = base + sizeof(kMagic) + sizeof(headerSize_);
+  dataBegin_ = alignSnapshot(sizeof(kMagic) + sizeof(headerSize_) + headerSize_);
+}
+
+void SnapshotReader::read(void* dst, size_t n) {
+  if (n > (size_t)(headerSize_ - pos_)) {
+    throw std::runtime_error("truncated snapshot header " + path_);
+  }
+  memcpy(dst, header_ + pos_, n);
+  pos_ += n;
+}
+
+int64_t SnapshotReader::readInt() {
+  int64_t v;
+  read(&v, sizeof(v));
+  return v;
+}
+
+std::string SnapshotReader::readString() {
+  int64_t size = readInt();
+  if (size < 0) {
+    throw std::runtime_error("corrupt snapshot header " + path_);
+  }
+  std::string s(size, '\0');
+  read(&s[0], size);
+  return s;
+}
+
+torch::Tensor SnapshotReader::readTensor() {
+  auto corrupt = [this]() { return std::runtime_error("corrupt snapshot " + path_); };
+  int64_t fileSize = mapping_->size;
+  int64_t scalarType = readInt();
+  if (scalarType < 0 || scalarType >= (int64_t)torch::ScalarType::NumOptions) {
+    throw corrupt();
+  }
+  auto dtype = (torch::ScalarType)scalarType;
+  int64_t dim = readInt();
+  if (dim < 0 || dim > headerSize_) {
+    throw corrupt();
+  }
+  std::vector<int64_t> sizes(dim);
+  int64_t nbytes = c10::elementSize(dtype);
+  for (auto& size : sizes) {
+    size = readInt();
+    // bounded by the file on every step, so the product cannot overflow
+    if (size < 0 || (size > 0 && nbytes > fileSize / size)) {
+      throw corrupt();
+    }
+    nbytes *= size;
+  }
+  int64_t blobOffset = readInt();
+  if (blobOffset < 0 || blobOffset > fileSize - dataBegin_ - nbytes) {
+    throw std::runtime_error("truncated snapshot " + path_);
+  }
+  int64_t offset = dataBegin_ + blobOffset;
+  auto options = torch::TensorOptions().dtype(dtype);
+  char* data = static_cast<char*>(mapping_->data) + offset;
+  // the deleter holds a reference to keep the mapping alive with its views
+  auto mapping = mapping_;
+  return torch::from_blob(data, sizes, [mapping](void*) {}, options);
+}
+
+RNNTransition SnapshotReader::readTransition() {
+  RNNTransition t;
+  t.isStorage = true;
+  for (auto* dict : {&t.obs, &t.h0, &t.action}) {
+    int64_t size = readInt();
+    for (int64_t i = 0; i < size; ++i) {
+      auto key = readString();
+      (*dict)[key] = readTensor();
+    }
+  }
+  t.reward = readTensor();
+  t.bootstrap = readTensor();
+  t.seqLen = readTensor();
+  return t;
+}
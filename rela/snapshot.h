@@ -0,0 +1,78 @@
+// Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <torch/extension.h>
+
+#include "rela/transition.h"
+
+namespace rela {
+
+// Binary snapshot file: a header of fields followed by raw tensor blobs,
+// each aligned to kSnapshotAlign so that the reader can map them in place.
+// Fields are read back in the order they were written.
+//   [magic][header size][header][pad][blob 0][pad][blob 1]...
+constexpr int64_t kSnapshotAlign = 4096;
+
+class SnapshotWriter {
+ public:
+  // the file is written to path.tmp and renamed to path by close(), so an
+  // interrupted write never leaves a truncated snapshot behind
+  explicit SnapshotWriter(const std::string& path)
+      : path_(path) {
+  }
+
+  void writeInt(int64_t v);
+
+  void writeString(const std::string& s);
+
+  // t must stay alive and unchanged until close(), its data is streamed to
+  // the file there without an intermediate copy
+  void writeTensor(const torch::Tensor& t);
+
+  // all tensors of t, same lifetime requirement as writeTensor()
+  void writeTransition(const RNNTransition& t);
+
+  void close();
+
+ private:
+  const std::string path_;
+  std::string header_;
+  std::vector<torch::Tensor> blobs_;
+  int64_t blobBytes_ = 0;
+};
+
+class SnapshotReader {
+ public:
+  // maps the file copy on write: pages are read lazily and tensors returned
+  // by readTensor() may be modified without touching the file
+  explicit SnapshotReader(const std::string& path);
+
+  int64_t readInt();
+
+  std::string readString();
+
+  // view of the mapped blob, keeps the mapping alive
+  torch::Tensor readTensor();
+
+  // storage written by writeTransition(), its tensors are views as well
+  RNNTransition readTransition();
+
+ private:
+  struct Mapping;
+
+  void read(void* dst, size_t n);
+
+  const std::string path_;
+  std::shared_ptr<Mapping> mapping_;
+  const char* header_ = nullptr;
+  int64_t headerSize_ = 0;
+  int64_t pos_ = 0;
+  int64_t dataBegin_ = 0;
+};
+
+}  // namespace rela
@@ -0,0 +1,169 @@
+// Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved
+
+#include "rela/storage_codec.h"
+
+#include <cstdint>
+#include <stdexcept>
+
+using namespace rela;
+
+// bit i of a packed byte, msb first
+static torch::Tensor bitMask(const torch::Device& device) {
+  return torch::tensor({128, 64, 32, 16, 8, 4, 2, 1}, torch::kUInt8).to(device);
+}
+
+void StorageCodec::set(const std::string& key, const std::string& kind, int size) {
+  if (kind == "bits") {
+    set(key, Kind::kBits, size);
+  } else if (kind == "int16") {
+    set(key, Kind::kInt16, size);
+  } else if (kind == "none") {
+    assert(!initialized_);
+    entries_.erase(key);
+  } else {
+    throw std::runtime_error("unknown storage codec: " + kind);
+  }
+}
+
+void StorageCodec::set(const std::string& key, Kind kind, int size) {
+  assert(!initialized_);
+  if (kind == Kind::kInt16 && size > INT16_MAX + 1) {
+    throw std::runtime_error(
+        "int16 storage codec of " + key + ": vocabulary of " + std::to_string(size)
+        + " ids does not fit in int16");
+  }
+  Entry entry;
+  entry.kind = kind;
+  entry.size = size;
+  entries_[key] = entry;
+}
+
+void StorageCodec::init(const TensorDict& obs) {
+  assert(!initialized_);
+  for (auto& kv : entries_) {
+    auto it = obs.find(kv.first);
+    if (it == obs.end()) {
+      throw std::runtime_error("storage codec key not in obs: " + kv.first);
+    }
+    auto& entry = kv.second;
+    const auto& t = it->second;
+    assert(t.dim() >= 1);
+    entry.dim = t.size(-1);
+    entry.dtype = t.scalar_type();
+    auto error = [&kv](const std::string& msg) {
+      return std::runtime_error("storage codec of " + kv.first + ": " + msg);
+    };
+    if (entry.kind == Kind::kBits) {
+      if (entry.size > entry.dim) {
+        throw error(
+            std::to_string(entry.size) + " bits declared, obs has "
+            + std::to_string(entry.dim) + " features");
+      }
+      if (entry.size < 0) {
+        entry.size = entry.dim;
+      }
+      auto bits = t.narrow(-1, 0, entry.size);
+      if (bits.numel() > 0
+          && (bits.min().item<double>() < 0 || bits.max().item<double>() > 1)) {
+        throw error("bits are not all 0 or 1");
+      }
+    } else {
+      if (torch::isFloatingType(entry.dtype)) {
+        throw error("int16 of a floating point obs");
+      }
+      int64_t low = entry.size < 0 ? INT16_MIN : 0;
+      int64_t high = entry.size < 0 ? INT16_MAX : entry.size - 1;
+      if (t.numel() > 0
+          && (t.min().item<int64_t>() < low || t.max().item<int64_t>() > high)) {
+        throw error(
+            "ids out of [" + std::to_string(low) + ", " + std::to_string(high) + "]");
+      }
+    }
+  }
+  initialized_ = true;
+}
+
+void StorageCodec::save(SnapshotWriter& writer) const {
+  writer.writeInt(initialized_);
+  writer.writeInt(entries_.size());
+  for (const auto& kv : entries_) {
+    writer.writeString(kv.first);
+    writer.writeInt((int64_t)kv.second.kind);
+    writer.writeInt(kv.second.size);
+    writer.writeInt(kv.second.dim);
+    writer.writeInt((int64_t)kv.second.dtype);
+  }
+}
+
+void StorageCodec::load(SnapshotReader& reader) {
+  initialized_ = reader.readInt();
+  entries_.clear();
+  int64_t numEntry = reader.readInt();
+  for (int64_t i = 0; i < numEntry; ++i) {
+    auto key = reader.readString();
+    Entry entry;
+    entry.kind = (Kind)reader.readInt();
+    entry.size = reader.readInt();
+    entry.dim = reader.readInt();
+    entry.dtype = (torch::Dtype)reader.readInt();
+    entries_[key] = entry;
+  }
+}
+
+TensorDict StorageCodec::encode(const TensorDict& obs) const {
+  assert(initialized_);
+  TensorDict encoded = obs;
+  for (const auto& kv : entries_) {
+    encoded[kv.first] = encode(kv.second, obs.at(kv.first));
+  }
+  return encoded;
+}
+
+TensorDict StorageCodec::decode(const TensorDict& obs) const {
+  assert(initialized_);
+  TensorDict decoded = obs;
+  for (const auto& kv : entries_) {
+    decoded[kv.first] = decode(kv.second, obs.at(kv.first));
+  }
+  return decoded;
+}
+
+torch::Tensor StorageCodec::encode(const Entry& entry, const torch::Tensor& t) const {
+  // values were checked against the layout once, in init()
+  assert(t.size(-1) == entry.dim && t.scalar_type() == entry.dtype);
+  if (entry.kind == Kind::kInt16) {
+    return t.to(torch::kInt16);
+  }
+
+  int64_t numBit = entry.size;
+  int64_t numByte = (numBit + 7) / 8;
+  auto bits = t.narrow(-1, 0, numBit).to(torch::kUInt8);
+  bits = torch::constant_pad_nd(bits, {0, numByte * 8 - numBit});
+  auto shape = bits.sizes().vec();
+  shape.back() = numByte;
+  shape.push_back(8);
+  // at most one bit per product, the sum is the packed byte
+  auto packed = (bits.reshape(shape) * bitMask(t.device())).sum(-1, false, torch::kUInt8);
+  if (numBit == entry.dim) {
+    return packed;
+  }
+  auto rest = t.narrow(-1, numBit, entry.dim - numBit).contiguous();
+  return torch::cat({packed, rest.view(torch::kUInt8)}, -1);
+}
+
+torch::Tensor StorageCodec::decode(const Entry& entry, const torch::Tensor& t) const {
+  if (entry.kind == Kind::kInt16) {
+    return t.to(entry.dtype);
+  }
+
+  int64_t numBit = entry.size;
+  int64_t numByte = (numBit + 7) / 8;
+  auto packed = t.narrow(-1, 0, numByte).unsqueeze(-1);
+  auto bits = packed.bitwise_and(bitMask(t.device())).ne(0).flatten(-2);
+  auto decoded = bits.narrow(-1, 0, numBit).to(entry.dtype);
+  if (numBit == entry.dim) {
+    return decoded;
+  }
+  auto rest = t.narrow(-1, numByte, t.size(-1) - numByte).contiguous();
+  return torch::cat({decoded, rest.view(entry.dtype)}, -1);
+}
@@ -0,0 +1,70 @@
+// Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved
+
+#pragma once
+
+#include <string>
+#include <unordered_map>
+
+#include "rela/snapshot.h"
+#include "rela/tensor_dict.h"
+
+namespace rela {
+
+// Per key compression of the obs stored in a replay buffer. Keys are
+// encoded on append and decoded on sample, both along the last dim only, so
+// encoded tensors can be stored, gathered and moved to device in any layout.
+//   bits:  the first numBit features (all if numBit < 0) are 0/1 and packed
+//          8 per uint8, the remaining features are kept verbatim as bytes,
+//          e.g. the v0 belief at the end of priv_s
+//   int16: integer ids in [0, size) of a vocabulary of size <= 32768, e.g.
+//          priv_s_text tokens, size < 0 takes the whole int16 range
+// Keys without a codec are stored as they are. Lossless for valid inputs.
+// The declared layout is checked once against the first element in init(),
+// encode() does not look at the values again.
+class StorageCodec {
+ public:
+  enum class Kind { kBits, kInt16 };
+
+  // kind: "bits", "int16" or "none", size: numBit of bits, vocabulary
+  // size of int16
+  void set(const std::string& key, const std::string& kind, int size);
+
+  void set(const std::string& key, Kind kind, int size = -1);
+
+  bool empty() const {
+    return entries_.empty();
+  }
+
+  // record the raw size and dtype of every key with a codec from an
+  // unbatched element, must be called once before encode/decode. throws
+  // if obs does not match the declared codecs
+  void init(const TensorDict& obs);
+
+  TensorDict encode(const TensorDict& obs) const;
+
+  TensorDict decode(const TensorDict& obs) const;
+
+  // the entries and their recorded sizes, load() replaces the current ones
+  void save(SnapshotWriter& writer) const;
+
+  void load(SnapshotReader& reader);
+
+ private:
+  struct Entry {
+    Kind kind;
+    // numBit of bits, vocabulary size of int16
+    int size = -1;
+    // raw size of the last dim and raw dtype
+    int64_t dim = 0;
+    torch::Dtype dtype = torch::kFloat32;
+  };
+
+  torch::Tensor encode(const Entry& entry, const torch::Tensor& t) const;
+
+  torch::Tensor decode(const Entry& entry, const torch::Tensor& t) const;
+
+  std::unordered_map<std::string, Entry> entries_;
+  bool initialized_ = false;
+};
+
+}  // namespace rela
@@ -0,0 +1,85 @@
+// Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+namespace rela {
+
+// Binary tree over capacity non-negative weights where each inner node holds
+// the sum of its children. set() and find() are O(log capacity). Inner nodes
+// are recomputed from their children instead of adjusted by a delta, so the
+// sums do not drift however many updates are applied. Not thread safe.
+class SumTree {
+ public:
+  explicit SumTree(int capacity)
+      : capacity_(capacity) {
+    assert(capacity_ > 0);
+    leafBase_ = 1;
+    while (leafBase_ < capacity_) {
+      leafBase_ *= 2;
+    }
+    nodes_.resize(2 * leafBase_, 0);
+  }
+
+  void clear() {
+    std::fill(nodes_.begin(), nodes_.end(), 0);
+  }
+
+  int capacity() const {
+    return capacity_;
+  }
+
+  double sum() const {
+    return nodes_[1];
+  }
+
+  double get(int idx) const {
+    assert(idx >= 0 && idx < capacity_);
+    return nodes_[leafBase_ + idx];
+  }
+
+  void set(int idx, double weight) {
+    assert(idx >= 0 && idx < capacity_);
+    assert(weight >= 0);
+    int node = leafBase_ + idx;
+    nodes_[node] = weight;
+    node /= 2;
+    while (node >= 1) {
+      nodes_[node] = nodes_[2 * node] + nodes_[2 * node + 1];
+      node /= 2;
+    }
+  }
+
+  // index of the leaf whose range [prefix, prefix + weight) contains value,
+  // never a leaf of weight 0 as long as sum() > 0. value is clamped to
+  // [0, sum())
+  int find(double value) const {
+    assert(sum() > 0);
+    value = std::max(0.0, value);
+    int node = 1;
+    while (node < leafBase_) {
+      int left = 2 * node;
+      // an empty right subtree can only be hit through rounding
+      if (value < nodes_[left] || nodes_[left + 1] <= 0) {
+        node = left;
+      } else {
+        value -= nodes_[left];
+        node = left + 1;
+      }
+    }
+    int idx = node - leafBase_;
+    assert(idx < capacity_ && nodes_[node] > 0);
+    return idx;
+  }
+
+ private:
+  const int capacity_;
+  int leafBase_;
+  // nodes_[1] is the root, leaves are [leafBase_, leafBase_ + capacity_)
+  std::vector<double> nodes_;
+};
+
+}  // namespace rela
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <torch/extension.h>
+#include <sstream>
 #include <unordered_map>
 
 namespace rela {
@@ -215,5 +216,24 @@ inline std::vector<std::string> getKeys(const TensorDict d) {
   }
   return keys;
 }
+
+// one "key: [d0, d1, ...]" line per key, for logging
+inline std::string shapeString(const TensorDict& d, const std::string& indent = "") {
+  std::ostringstream oss;
+  for (const auto& kv : d) {
+    oss << indent << kv.first << ": ";
+    if (kv.second.dim() == 0) {
+      oss << "scalar";
+    } else {
+      oss << kv.second.sizes();
+    }
+    oss << "\n";
+  }
+  auto ret = oss.str();
+  if (!ret.empty()) {
+    ret.pop_back();
+  }
+  return ret;
+}
 }  // namespace tensor_dict
 }  // namespace rela
@@ -0,0 +1,129 @@
+// Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rela {
+
+// Fixed set of threads for data parallel loops, e.g. gathering a replay
+// batch. parallelFor blocks until every index has been processed, the
+// calling thread takes part in the work. Calls are serialized.
+class ThreadPool {
+ public:
+  explicit ThreadPool(int numThread) {
+    assert(numThread >= 0);
+    for (int i = 0; i < numThread; ++i) {
+      threads_.emplace_back(&ThreadPool::workerLoop, this);
+    }
+  }
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lk(m_);
+      exit_ = true;
+    }
+    cvWork_.notify_all();
+    for (auto& t : threads_) {
+      t.join();
+    }
+  }
+
+  int numThread() const {
+    return (int)threads_.size();
+  }
+
+  // run fn(i) for i in [0, n)
+  void parallelFor(int n, const std::function<void(int)>& fn) {
+    std::lock_guard<std::mutex> lkCall(mCall_);
+    if (threads_.empty() || n <= 1) {
+      for (int i = 0; i < n; ++i) {
+        fn(i);
+      }
+      return;
+    }
+
+    {
+      std::lock_guard<std::mutex> lk(m_);
+      fn_ = &fn;
+      n_ = n;
+      next_ = 0;
+      numRunning_ = (int)threads_.size();
+      ++round_;
+    }
+    cvWork_.notify_all();
+
+    runTasks(fn, n);
+
+    std::unique_lock<std::mutex> lk(m_);
+    cvDone_.wait(lk, [this] { return numRunning_ == 0; });
+    fn_ = nullptr;
+  }
+
+ private:
+  void runTasks(const std::function<void(int)>& fn, int n) {
+    while (true) {
+      int i = next_++;
+      if (i >= n) {
+        return;
+      }
+      fn(i);
+    }
+  }
+
+  void workerLoop() {
+    uint64_t seen = 0;
+    while (true) {
+      const std::function<void(int)>* fn = nullptr;
+      int n = 0;
+      {
+        std::unique_lock<std::mutex> lk(m_);
+        cvWork_.wait(lk, [&] { return exit_ || round_ != seen; });
+        if (exit_) {
+          return;
+        }
+        seen = round_;
+        fn = fn_;
+        n = n_;
+      }
+
+      runTasks(*fn, n);
+
+      bool last = false;
+      {
+        std::lock_guard<std::mutex> lk(m_);
+        last = (--numRunning_ == 0);
+      }
+      if (last) {
+        cvDone_.notify_one();
+      }
+    }
+  }
+
+  std::vector<std::thread> threads_;
+
+  std::mutex mCall_;
+  std::mutex m_;
+  std::condition_variable cvWork_;
+  std::condition_variable cvDone_;
+  // current round, protected by m_
+  const std::function<void(int)>* fn_ = nullptr;
+  int n_ = 0;
+  int numRunning_ = 0;
+  uint64_t round_ = 0;
+  bool exit_ = false;
+
+  std::atomic<int> next_{0};
+};
+
+}  // namespace rela
@@ -6,32 +6,103 @@
 
 using namespace rela;
 
-RNNTransition::RNNTransition(const RNNTransition& tau, int bsz) {
+// storage of bsz elements like t, the element dim is inserted at 1 (after the
+// time or layer dim) for the seq first layout
+static std::vector<int64_t> getStorageSize(const torch::Tensor& t, int bsz, bool seqFirst) {
+  auto sizes = getBatchedSize(t, bsz);
+  if (seqFirst && t.dim() > 0) {
+    std::swap(sizes[0], sizes[1]);
+  }
+  return sizes;
+}
+
+static TensorDict allocateStorage(const TensorDict& data, int bsz, bool seqFirst) {
+  TensorDict storage;
+  for (const auto& kv : data) {
+    auto sizes = getStorageSize(kv.second, bsz, seqFirst);
+    storage[kv.first] = torch::zeros(sizes, kv.second.dtype());
+  }
+  return storage;
+}
+
+RNNTransition::RNNTransition(const RNNTransition& tau, int bsz, bool seqFirst) {
   isStorage = true;
+  seqFirstStorage = seqFirst;
 
-  obs = allocateBatchStorage(tau.obs, bsz);
-  action = allocateBatchStorage(tau.action, bsz);
-  h0 = allocateBatchStorage(tau.h0, bsz);
-  reward = torch::zeros(getBatchedSize(tau.reward, bsz));
-  bootstrap = torch::zeros(getBatchedSize(tau.bootstrap, bsz));
+  obs = allocateStorage(tau.obs, bsz, seqFirst);
+  action = allocateStorage(tau.action, bsz, seqFirst);
+  h0 = allocateStorage(tau.h0, bsz, seqFirst);
+  reward = torch::zeros(getStorageSize(tau.reward, bsz, seqFirst));
+  bootstrap = torch::zeros(getStorageSize(tau.bootstrap, bsz, seqFirst));
   seqLen = torch::zeros(bsz);
 }
 
+int RNNTransition::elementDim(const torch::Tensor& t) const {
+  return (seqFirstStorage && t.dim() > 1) ? 1 : 0;
+}
+
 void RNNTransition::paste_(const RNNTransition& tau, int idx) {
   assert(isStorage);
 
+  auto paste = [&](torch::Tensor& t, const torch::Tensor& src) {
+    t.select(elementDim(t), idx).copy_(src);
+  };
   for (auto& kv: tau.obs) {
-    obs[kv.first][idx] = kv.second;
+    paste(obs[kv.first], kv.second);
   }
   for (auto& kv: tau.action) {
-    action[kv.first][idx] = kv.second;
+    paste(action[kv.first], kv.second);
   }
   for (auto& kv: tau.h0) {
-    h0[kv.first][idx] = kv.second;
+    paste(h0[kv.first], kv.second);
+  }
+  paste(reward, tau.reward);
+  paste(bootstrap, tau.bootstrap);
+  paste(seqLen, tau.seqLen);
+}
+
+void RNNTransition::pasteBlock_(const RNNTransition& block, int from, int to, int n) {
+  assert(isStorage);
+  assert(block.isStorage && !block.seqFirstStorage);
+
+  // elements of block are always along dim 0
+  auto paste = [&](torch::Tensor& t, const torch::Tensor& src) {
+    int dim = elementDim(t);
+    auto rows = src.narrow(0, from, n);
+    t.narrow(dim, to, n).copy_(dim == 0 ? rows : rows.transpose(0, dim));
+  };
+  for (auto& kv : block.obs) {
+    paste(obs[kv.first], kv.second);
+  }
+  for (auto& kv : block.action) {
+    paste(action[kv.first], kv.second);
   }
-  reward[idx] = tau.reward;
-  bootstrap[idx] = tau.bootstrap;
-  seqLen[idx] = tau.seqLen;
+  for (auto& kv : block.h0) {
+    paste(h0[kv.first], kv.second);
+  }
+  paste(reward, block.reward);
+  paste(bootstrap, block.bootstrap);
+  paste(seqLen, block.seqLen);
+}
+
+RNNTransition RNNTransition::asBlock() const {
+  auto unsqueeze = [](const TensorDict& dict) {
+    TensorDict block;
+    for (auto& kv : dict) {
+      block.insert({kv.first, kv.second.unsqueeze(0)});
+    }
+    return block;
+  };
+
+  RNNTransition block;
+  block.isStorage = true;
+  block.obs = unsqueeze(obs);
+  block.h0 = unsqueeze(h0);
+  block.action = unsqueeze(action);
+  block.reward = reward.unsqueeze(0);
+  block.bootstrap = bootstrap.unsqueeze(0);
+  block.seqLen = seqLen.unsqueeze(0);
+  return block;
 }
 
 RNNTransition RNNTransition::index(int i) const {
@@ -40,18 +111,18 @@ RNNTransition RNNTransition::index(int i) const {
   RNNTransition element;
 
   for (auto& name2tensor : obs) {
-    element.obs.insert({name2tensor.first, name2tensor.second[i]});
+    element.obs.insert({name2tensor.first, select(name2tensor.second, i)});
   }
   for (auto& name2tensor : h0) {
-    element.h0.insert({name2tensor.first, name2tensor.second[i]});
+    element.h0.insert({name2tensor.first, select(name2tensor.second, i)});
   }
   for (auto& name2tensor : action) {
-    element.action.insert({name2tensor.first, name2tensor.second[i]});
+    element.action.insert({name2tensor.first, select(name2tensor.second, i)});
   }
 
-  element.reward = reward[i];
-  element.bootstrap = bootstrap[i];
-  element.seqLen = seqLen[i];
+  element.reward = select(reward, i);
+  element.bootstrap = select(bootstrap, i);
+  element.seqLen = select(seqLen, i);
   return element;
 }
 
@@ -60,18 +131,18 @@ void RNNTransition::copyTo(int from, RNNTransition& dst, int to) const {
   assert(dst.isStorage);
 
   for (auto& kv : obs) {
-    dst.obs[kv.first][to] = kv.second[from];
+    dst.select(dst.obs[kv.first], to).copy_(select(kv.second, from));
   }
   for (auto& kv : h0) {
-    dst.h0[kv.first][to] = kv.second[from];
+    dst.select(dst.h0[kv.first], to).copy_(select(kv.second, from));
   }
   for (auto& kv : action) {
-    dst.action[kv.first][to] = kv.second[from];
+    dst.select(dst.action[kv.first], to).copy_(select(kv.second, from));
   }
 
-  dst.reward[to] = reward[from];
-  dst.bootstrap[to] = bootstrap[from];
-  dst.seqLen[to] = seqLen[from];
+  dst.select(dst.reward, to).copy_(select(reward, from));
+  dst.select(dst.bootstrap, to).copy_(select(bootstrap, from));
+  dst.select(dst.seqLen, to).copy_(select(seqLen, from));
 }
 
 void RNNTransition::to_(const std::string& device) {
@@ -104,6 +175,68 @@ void RNNTransition::seqFirst_() {
   // no need to transpose seqLen
 }
 
+torch::Tensor RNNTransition::allocateSeqFirstTensor(
+    const torch::Tensor& storage, int bsz, bool pinned) const {
+  auto sizes = storage.sizes().vec();
+  sizes[elementDim(storage)] = bsz;
+  if (sizes.size() > 1 && !seqFirstStorage) {
+    std::swap(sizes[0], sizes[1]);
+  }
+  auto options = torch::TensorOptions().dtype(storage.dtype()).pinned_memory(pinned);
+  return torch::empty(sizes, options);
+}
+
+void RNNTransition::gatherSeqFirstTensor(
+    const torch::Tensor& storage, const torch::Tensor& ids, torch::Tensor& dst, int begin)
+    const {
+  int dim = elementDim(storage);
+  auto rows = storage.index_select(dim, ids);
+  if (dst.dim() == 1) {
+    dst.narrow(0, begin, ids.size(0)).copy_(rows);
+  } else if (dim == 1) {
+    // already [T, n, ...], a plain strided copy
+    dst.narrow(1, begin, ids.size(0)).copy_(rows);
+  } else {
+    // rows is [n, T, ...], transposed while it is still in cache
+    dst.narrow(1, begin, ids.size(0)).copy_(rows.transpose(0, 1));
+  }
+}
+
+RNNTransition RNNTransition::allocateSeqFirst(int bsz, bool pinned) const {
+  assert(isStorage);
+  RNNTransition batch;
+  for (auto& kv : obs) {
+    batch.obs[kv.first] = allocateSeqFirstTensor(kv.second, bsz, pinned);
+  }
+  for (auto& kv : h0) {
+    batch.h0[kv.first] = allocateSeqFirstTensor(kv.second, bsz, pinned);
+  }
+  for (auto& kv : action) {
+    batch.action[kv.first] = allocateSeqFirstTensor(kv.second, bsz, pinned);
+  }
+  batch.reward = allocateSeqFirstTensor(reward, bsz, pinned);
+  batch.bootstrap = allocateSeqFirstTensor(bootstrap, bsz, pinned);
+  batch.seqLen = allocateSeqFirstTensor(seqLen, bsz, pinned);
+  return batch;
+}
+
+void RNNTransition::gatherSeqFirst(
+    const torch::Tensor& ids, RNNTransition& dst, int begin) const {
+  assert(isStorage);
+  for (auto& kv : obs) {
+    gatherSeqFirstTensor(kv.second, ids, dst.obs.at(kv.first), begin);
+  }
+  for (auto& kv : h0) {
+    gatherSeqFirstTensor(kv.second, ids, dst.h0.at(kv.first), begin);
+  }
+  for (auto& kv : action) {
+    gatherSeqFirstTensor(kv.second, ids, dst.action.at(kv.first), begin);
+  }
+  gatherSeqFirstTensor(reward, ids, dst.reward, begin);
+  gatherSeqFirstTensor(bootstrap, ids, dst.bootstrap, begin);
+  gatherSeqFirstTensor(seqLen, ids, dst.seqLen, begin);
+}
+
 RNNTransition rela::makeBatch(
     const std::vector<RNNTransition>& transitions, const std::string& device) {
   std::vector<TensorDict> obsVec;
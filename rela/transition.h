@@ -12,18 +12,36 @@ class RNNTransition {
  public:
   RNNTransition() = default;
 
-  RNNTransition(const RNNTransition&, int bsz);
+  // storage of bsz elements like the given one. batch major [bsz, T, ...]
+  // by default, seqFirst stores [T, bsz, ...] (h0: [numLayer, bsz, ...]), the
+  // layout the learner consumes, so batches are gathered without a transpose
+  RNNTransition(const RNNTransition&, int bsz, bool seqFirst = false);
 
   void paste_(const RNNTransition&, int idx);
 
+  // copy elements [from, from + n) of block, a batch major storage, into
+  // elements [to, to + n), one copy per key
+  void pasteBlock_(const RNNTransition& block, int from, int to, int n);
+
   RNNTransition index(int i) const;
 
+  // this element as a batch major storage of one element, a view
+  RNNTransition asBlock() const;
+
   void copyTo(int from, RNNTransition& dst, int to) const;
 
   void to_(const std::string& device);
 
   void seqFirst_();
 
+  // empty batch of bsz elements of this storage in the layout seqFirst_()
+  // produces: [T, bsz, ...] (h0: [numLayer, bsz, ...]), seqLen is [bsz]
+  RNNTransition allocateSeqFirst(int bsz, bool pinned) const;
+
+  // copy storage rows ids into elements [begin, begin + ids.size()) of a
+  // seq first batch, one index_select per key
+  void gatherSeqFirst(const torch::Tensor& ids, RNNTransition& dst, int begin) const;
+
   TensorDict obs;
   TensorDict h0;
   TensorDict action;
@@ -32,6 +50,24 @@ class RNNTransition {
   torch::Tensor seqLen;
 
   bool isStorage = false;
+  bool seqFirstStorage = false;
+
+ private:
+  // dim indexing the elements of a storage tensor
+  int elementDim(const torch::Tensor& t) const;
+
+  torch::Tensor select(const torch::Tensor& t, int i) const {
+    return t.select(elementDim(t), i);
+  }
+
+  torch::Tensor allocateSeqFirstTensor(
+      const torch::Tensor& storage, int bsz, bool pinned) const;
+
+  void gatherSeqFirstTensor(
+      const torch::Tensor& storage,
+      const torch::Tensor& ids,
+      torch::Tensor& dst,
+      int begin) const;
 };
 
 
@@ -0,0 +1,154 @@
+#include <chrono>
+
+#include "rela/work_stealing.h"
+
+namespace rela {
+
+WorkStealingExecutor::WorkStealingExecutor(std::shared_ptr<TaskSet> tasks, int numWorker)
+    : tasks_(std::move(tasks))
+    , numWorker_(numWorker)
+    , readyQueue_(std::make_shared<ReadyQueue>())
+    , state_(new std::atomic<int>[tasks_->size()]) {
+  assert(numWorker_ > 0);
+  for (int i = 0; i < numWorker_; ++i) {
+    workers_.push_back(std::make_unique<Worker>());
+  }
+  tasks_->setReadyQueue(readyQueue_);
+  reset();
+}
+
+void WorkStealingExecutor::reset() {
+  for (auto& w : workers_) {
+    std::lock_guard<std::mutex> lk(w->m);
+    w->tasks.clear();
+  }
+  // same initial split as the static partition of HanabiThreadLoop
+  int size = tasks_->size();
+  for (int i = 0; i < size; ++i) {
+    state_[i] = kQueued;
+    workers_[(int64_t)i * numWorker_ / size]->tasks.push_back(i);
+  }
+}
+
+void WorkStealingExecutor::push(int worker, int task) {
+  auto& w = *workers_[worker];
+  {
+    std::lock_guard<std::mutex> lk(w.m);
+    w.tasks.push_back(task);
+  }
+  // pairs with the increment in run(), either the idle worker sees the
+  // task when it steals or it is interrupted here
+  if (numIdle_.load() > 0) {
+    readyQueue_->interrupt(1);
+  }
+}
+
+bool WorkStealingExecutor::pop(int worker, int* task) {
+  auto& w = *workers_[worker];
+  std::lock_guard<std::mutex> lk(w.m);
+  if (w.tasks.empty()) {
+    return false;
+  }
+  *task = w.tasks.front();
+  w.tasks.pop_front();
+  return true;
+}
+
+bool WorkStealingExecutor::steal(int worker, int* task) {
+  std::vector<int> stolen;
+  for (int k = 1; k < numWorker_ && stolen.empty(); ++k) {
+    auto& victim = *workers_[(worker + k) % numWorker_];
+    std::lock_guard<std::mutex> lk(victim.m);
+    // take the back half, the victim keeps the tasks it will run next
+    int n = (int)(victim.tasks.size() + 1) / 2;
+    for (int i = 0; i < n; ++i) {
+      stolen.push_back(victim.tasks.back());
+      victim.tasks.pop_back();
+    }
+  }
+  if (stolen.empty()) {
+    return false;
+  }
+
+  numSteal_ += (int64_t)stolen.size();
+  *task = stolen.back();
+  stolen.pop_back();
+  auto& w = *workers_[worker];
+  std::lock_guard<std::mutex> lk(w.m);
+  w.tasks.insert(w.tasks.end(), stolen.rbegin(), stolen.rend());
+  return true;
+}
+
+void WorkStealingExecutor::wake(int worker, const std::vector<int>& tags) {
+  for (int task : tags) {
+    int s = kParked;
+    if (state_[task].compare_exchange_strong(s, kQueued)) {
+      push(worker, task);
+    } else if (s == kRunning) {
+      // the running worker requeues it, retry if it parked in between
+      if (!state_[task].compare_exchange_strong(s, kRunningWoken) && s == kParked) {
+        if (state_[task].compare_exchange_strong(s, kQueued)) {
+          push(worker, task);
+        }
+      }
+    }
+    // already queued or flagged, nothing to do
+  }
+}
+
+void WorkStealingExecutor::run(int worker, ThreadLoop& loop) {
+  // the shared queue is drained when the local deque runs dry and every
+  // kDrainInterval steps, so that woken tasks are not held back by tasks
+  // that keep running again
+  constexpr int kDrainInterval = 64;
+  // only bounds the wait, idle workers are interrupted on push and terminate
+  constexpr auto kParkTimeout = std::chrono::milliseconds(100);
+
+  std::vector<int> tags;
+  int64_t numStep = 0;
+  while (!loop.terminated()) {
+    if (loop.paused()) {
+      loop.waitUntilResume();
+    }
+    if (tasks_->finished()) {
+      // the other workers may be parked
+      interrupt();
+      return;
+    }
+
+    int task = -1;
+    bool found = pop(worker, &task);
+    if (!found || ++numStep % kDrainInterval == 0) {
+      tags.clear();
+      readyQueue_->popAll(tags, std::chrono::milliseconds(0));
+      wake(worker, tags);
+      found = found || pop(worker, &task);
+    }
+    if (!found && !steal(worker, &task)) {
+      // announce before the last steal, see push()
+      ++numIdle_;
+      found = steal(worker, &task);
+      if (!found) {
+        tags.clear();
+        readyQueue_->popAll(tags, kParkTimeout);
+      }
+      --numIdle_;
+      if (!found) {
+        wake(worker, tags);
+        continue;
+      }
+    }
+
+    state_[task] = kRunning;
+    bool again = tasks_->step(task);
+
+    int s = kRunning;
+    if (again || !state_[task].compare_exchange_strong(s, kParked)) {
+      // made progress, or a reply arrived while it was running
+      state_[task] = kQueued;
+      push(worker, task);
+    }
+  }
+}
+
+}  // namespace rela
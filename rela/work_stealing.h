@@ -0,0 +1,129 @@
+// Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved
+
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "rela/ready_queue.h"
+#include "rela/thread_loop.h"
+
+namespace rela {
+
+// A fixed set of tasks [0, size()), e.g. one per env. step(i) is never
+// called concurrently for the same i.
+class TaskSet {
+ public:
+  virtual ~TaskSet() {
+  }
+
+  virtual int size() const = 0;
+
+  // tasks push their index onto queue when they can make progress again,
+  // e.g. when one of their replies arrives
+  virtual void setReadyQueue(std::shared_ptr<ReadyQueue> queue) = 0;
+
+  // run one step of task i. returns true if it should run again right
+  // away, false if it waits for a wake up on the ready queue or is done
+  virtual bool step(int i) = 0;
+
+  // no task will ever make progress again
+  virtual bool finished() const {
+    return false;
+  }
+};
+
+// Runs a TaskSet on numWorker threads. Each worker owns a deque of runnable
+// tasks, runs them in FIFO order and steals half of the deque of another
+// worker when its own is empty, so a few slow tasks do not hold back the
+// tasks that happen to share a thread with them. Idle workers park on the
+// ready queue until a reply arrives or another worker queues a task. Each
+// worker is a WorkStealingLoop pushed into a Context.
+class WorkStealingExecutor {
+ public:
+  WorkStealingExecutor(std::shared_ptr<TaskSet> tasks, int numWorker);
+
+  WorkStealingExecutor(const WorkStealingExecutor&) = delete;
+  WorkStealingExecutor& operator=(const WorkStealingExecutor&) = delete;
+
+  int numWorker() const {
+    return numWorker_;
+  }
+
+  // main loop of worker, returns when loop is terminated or tasks finished
+  void run(int worker, ThreadLoop& loop);
+
+  // wake every idle worker, e.g. to see that its loop is terminated
+  void interrupt() {
+    readyQueue_->interrupt(numWorker_);
+  }
+
+  // put every task back in the queues, e.g. after the tasks have been
+  // reset for another round of evaluation. workers must not be running
+  void reset();
+
+  // #tasks taken from another worker
+  int64_t numSteal() const {
+    return numSteal_.load();
+  }
+
+ private:
+  enum TaskState : int {
+    kParked = 0,
+    kQueued = 1,
+    kRunning = 2,
+    // woken up while running, requeue once the step is done
+    kRunningWoken = 3,
+  };
+
+  struct Worker {
+    std::mutex m;
+    std::deque<int> tasks;
+  };
+
+  void push(int worker, int task);
+
+  bool pop(int worker, int* task);
+
+  bool steal(int worker, int* task);
+
+  // move the tasks reported by the ready queue into worker's deque
+  void wake(int worker, const std::vector<int>& tags);
+
+  const std::shared_ptr<TaskSet> tasks_;
+  const int numWorker_;
+  const std::shared_ptr<ReadyQueue> readyQueue_;
+
+  std::unique_ptr<std::atomic<int>[]> state_;
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::atomic<int64_t> numSteal_{0};
+  // #workers parked on readyQueue_, push() wakes one of them
+  std::atomic<int> numIdle_{0};
+};
+
+class WorkStealingLoop : public ThreadLoop {
+ public:
+  WorkStealingLoop(std::shared_ptr<WorkStealingExecutor> executor, int worker)
+      : executor_(std::move(executor))
+      , worker_(worker) {
+    assert(worker_ >= 0 && worker_ < executor_->numWorker());
+  }
+
+  virtual void terminate() override {
+    ThreadLoop::terminate();
+    executor_->interrupt();
+  }
+
+  virtual void mainLoop() override {
+    executor_->run(worker_, *this);
+  }
+
+ private:
+  std::shared_ptr<WorkStealingExecutor> executor_;
+  const int worker_;
+};
+
+}  // namespace rela